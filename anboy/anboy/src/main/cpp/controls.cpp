@@ -14,6 +14,7 @@ bool pressed_direction, pressed_button = false;
  * Process the next input event.
  */
 int32_t engine_handle_input(struct android_app *app, AInputEvent *event) {
+    Gameboy *gb = ((struct engine *)app->userData)->gameboy;
     int32_t eventType = AInputEvent_getType(event);
     if (eventType == AINPUT_EVENT_TYPE_MOTION && AInputEvent_getSource(event) == AINPUT_SOURCE_TOUCHSCREEN) {
         int action = AKeyEvent_getAction(event) & AMOTION_EVENT_ACTION_MASK;
@@ -27,25 +28,25 @@ int32_t engine_handle_input(struct android_app *app, AInputEvent *event) {
             if (!pressed_direction) {
                 if (down_y > (float)get_display_height() / 2) {
                     // A button
-                    press(CBOY_KEY_A);
+                    press(gb, CBOY_KEY_A);
                 } else if (down_y > (float)get_display_height() / 4) {
                     if (down_x < (float)get_display_width() / 2) {
                         // select
-                        press(SELECT);
+                        press(gb, SELECT);
                     } else {
                         // start
-                        press(START);
+                        press(gb, START);
                     }
                 } else {
                     if (down_x < (float)get_display_width() / 2) {
-                        load_state();
+                        load_state(gb);
                     } else {
-                        save_state();
+                        save_state(gb);
                     }
                 }
                 pressed_button = true;
             } else {
-                release_all();
+                release_all(gb);
                 pressed_direction = false;
             }
             break;
@@ -63,18 +64,18 @@ int32_t engine_handle_input(struct android_app *app, AInputEvent *event) {
                 break;
             } else if (abs(delta_x) > abs(delta_y)) {
                 if (delta_x > 0) {
-                    press(RIGHT);
+                    press(gb, RIGHT);
                 } else {
                     // left
-                    press(LEFT);
+                    press(gb, LEFT);
                 }
             } else {
                 if (delta_y > 0) {
                     // down
-                    press(DOWN);
+                    press(gb, DOWN);
                 } else {
                     // up
-                    press(UP);
+                    press(gb, UP);
                 }
             }
             pressed_direction = true;
@@ -84,11 +85,11 @@ int32_t engine_handle_input(struct android_app *app, AInputEvent *event) {
     return 0;
 }
 
-void release_button() {
+void release_button(Gameboy *gb) {
     if (pressed_button) {
         pressed_button = false;
-        release(CBOY_KEY_A);
-        release(SELECT);
-        release(START);
+        release(gb, CBOY_KEY_A);
+        release(gb, SELECT);
+        release(gb, START);
     }
 }
\ No newline at end of file
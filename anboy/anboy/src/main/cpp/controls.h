@@ -5,8 +5,10 @@
 
 #include <android_native_app_glue.h>
 
+#include <gameboy.h>
+
 int32_t engine_handle_input(struct android_app *app, AInputEvent *event);
 
-void release_button();
+void release_button(Gameboy *gb);
 
 #endif // ANBOY_CONTROLS_H
\ No newline at end of file
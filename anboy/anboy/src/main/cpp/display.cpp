@@ -7,7 +7,8 @@
 static int32_t display_height;
 static int32_t display_width;
 
-GLfloat colors[WIDTH * HEIGHT * 4];
+// the RGBA8888 frame, drawn into by the emulator and used as the color array of the points
+GLubyte colors[WIDTH * HEIGHT * 4];
 GLshort points[WIDTH * HEIGHT * 2];
 
 /**
@@ -104,17 +105,14 @@ int engine_init_display(struct engine *engine) {
     return 0;
 }
 
-void draw_color(unsigned char x, unsigned char y, short color) {
-    colors[(y * 4 * WIDTH) + 4 * x] = (float)(color & 0x1f) / 32;
-    colors[(y * 4 * WIDTH) + 4 * x + 1] = (float)((color >> 5) & 0x1f) / 32;
-    colors[(y * 4 * WIDTH) + 4 * x + 2] = (float)((color >> 10) & 0x1f) / 32;
-    colors[(y * 4 * WIDTH) + 4 * x + 3] = 1;
+void engine_set_frame_output(struct engine *engine) {
+    set_frame_output(engine->gameboy, colors, WIDTH * 4, PIXEL_RGBA8888);
 }
 
 /**
  * Just the current frame in the display.
  */
-void engine_draw_frame(struct engine *engine, unsigned short buffer[HEIGHT][WIDTH]) {
+void engine_draw_frame(struct engine *engine) {
 
     if (engine->display == NULL) {
         // No display.
@@ -126,14 +124,8 @@ void engine_draw_frame(struct engine *engine, unsigned short buffer[HEIGHT][WIDT
     glEnableClientState(GL_VERTEX_ARRAY);
     glEnableClientState(GL_COLOR_ARRAY);
 
-    for (unsigned char y = 0; y < HEIGHT; y++) {
-        for (unsigned char x = 0; x < WIDTH; x++) {
-            draw_color(x, y, buffer[y][x]);
-        }
-    }
-
     glVertexPointer(2, GL_SHORT, 0, points);
-    glColorPointer(4, GL_FLOAT, 0, colors);
+    glColorPointer(4, GL_UNSIGNED_BYTE, 0, colors);
     glClear(GL_COLOR_BUFFER_BIT);
     glDrawArrays(GL_POINTS, 0, WIDTH * HEIGHT);
 
@@ -9,6 +9,8 @@
 #include <android/log.h>
 #include <android_native_app_glue.h>
 
+#include <gameboy.h>
+
 #define WIDTH 160
 #define HEIGHT 144
 
@@ -21,7 +23,10 @@ int32_t get_display_height();
 
 int engine_init_display(struct engine *engine);
 
-void engine_draw_frame(struct engine *engine, unsigned short buffer[HEIGHT][WIDTH]);
+// lets the emulator draw straight into the colors of the points
+void engine_set_frame_output(struct engine *engine);
+
+void engine_draw_frame(struct engine *engine);
 
 void engine_term_display(struct engine *engine);
 
@@ -36,6 +41,8 @@ struct engine {
     EGLContext context;
     int32_t width;
     int32_t height;
+
+    Gameboy *gameboy;
 };
 
 #endif // ANBOY_DISPLAY_H
\ No newline at end of file
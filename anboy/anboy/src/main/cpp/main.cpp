@@ -9,6 +9,8 @@
 #include <cpu.h>
 #include <gameboy.h>
 
+static Gameboy gameboy;
+
 /**
  * Process the next main command.
  */
@@ -41,6 +43,7 @@ void android_main(struct android_app *state) {
     state->onAppCmd = engine_handle_cmd;
     state->onInputEvent = engine_handle_input;
     engine.app = state;
+    engine.gameboy = &gameboy;
 
     jobject object = state->activity->clazz;
 
@@ -58,7 +61,11 @@ void android_main(struct android_app *state) {
     env->ReleaseStringUTFChars(data, path);
 
     LOGI("starting rom: %s", path);
-    load_rom(const_cast<char *>(path));
+    load_rom(&gameboy, const_cast<char *>(path));
+    engine_set_frame_output(&engine);
+
+    Pacer pacer;
+    init_pacer(&pacer);
 
     while (true) {
         // Read all pending events.
@@ -82,13 +89,16 @@ void android_main(struct android_app *state) {
             }
         }
 
-        Frame buffer = next_frame();
-        engine_draw_frame(&engine, buffer.buffer);
+        next_frame(&gameboy);
+        engine_draw_frame(&engine);
+        pace_frame(&pacer);
 
-        release_button();
+        release_button(&gameboy);
     }
 }
 
-void serial_print(char c) {
+void serial_print(Gameboy *gb, char c) {
     // no output
+    (void)gb;
+    (void)c;
 }
\ No newline at end of file
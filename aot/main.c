@@ -0,0 +1,551 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+/*
+ * cboy-aot, translates the code of a ROM to C ahead of time.
+ *
+ * Walks the code reachable from the entry point, the RST and the interrupt vectors along every jump, call
+ * and fall through whose target is known statically. Every block found is decoded by the block cache, so
+ * it matches the block the interpreter would run, and written out as a function that checks the same exit
+ * conditions as run_block in cpu.c. Register, ALU and memory instructions and the jump that ends a block are
+ * translated to C, all others call their instruction handler.
+ *
+ * Targets in 4000-7FFF reached from 0000-3FFF are translated for every ROM bank, as the bank that is
+ * mapped at runtime is not known.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gameboy.h"
+#include "instructions/opcodes.h"
+
+#define NAME(OPCODE, HANDLER) [OPCODE] = #HANDLER,
+#define NAME_NONE(OPCODE) [OPCODE] = "NOP",
+
+static const char *names[0x100] = {OPCODES(NAME, NAME, NAME, NAME_NONE, NAME_NONE)};
+
+typedef struct {
+    unsigned char bank;
+    unsigned short pc;
+} Entry;
+
+static Gameboy gameboy;
+
+static unsigned char visited[0x100][0x4000 / 8];
+
+static Entry *entries;
+static unsigned int count, capacity;
+
+static unsigned int banks;
+
+void serial_print(Gameboy *gb, char c) {
+    (void)gb;
+    (void)c;
+}
+
+static void push(unsigned char bank, unsigned short pc) {
+    unsigned short offset = pc & 0x3FFF;
+    if (visited[bank][offset >> 3] >> (offset & 7) & 1)
+        return;
+    visited[bank][offset >> 3] |= 1 << (offset & 7);
+
+    if (count == capacity) {
+        capacity = capacity ? capacity * 2 : 1024;
+        entries = realloc(entries, capacity * sizeof(Entry));
+    }
+    entries[count++] = (Entry){.bank = bank, .pc = pc};
+}
+
+// queues a jump target, bank is the one of the block the jump is in
+static void follow(unsigned char bank, unsigned short target) {
+    if (target < 0x4000) {
+        push(0, target);
+    } else if (target < 0x8000) {
+        if (bank != 0) {
+            push(bank, target);
+        } else {
+            for (unsigned int i = 1; i < banks; i++)
+                push(i, target);
+        }
+    }
+    // code in RAM is left to the interpreter
+}
+
+static void map_bank(unsigned char bank) {
+    if (bank != 0 && gameboy.mmu.mbc.rom_bank_number != bank) {
+        gameboy.mmu.mbc.rom_bank_number = bank;
+        map_memory(&gameboy, 0x40, 0x7F);
+    }
+}
+
+// false if there is no instruction at entry, like when the first one crosses the end of its region
+static bool decode(Entry entry, Block *block) {
+    map_bank(entry.bank);
+    return decode_block(&gameboy, block, entry.pc, entry.bank) != NULL;
+}
+
+static void walk(Entry entry) {
+    Block block;
+
+    if (!decode(entry, &block))
+        return;
+
+    unsigned short end = entry.pc;
+    for (unsigned char i = 0; i < block.count; i++)
+        end += block.instructions[i].length;
+
+    Decoded *last = &block.instructions[block.count - 1];
+    unsigned char opcode = last->operand == OPERAND_CB ? 0xCB : last->opcode;
+
+    switch (opcode) {
+    case 0x18: case 0x20: case 0x28: case 0x30: case 0x38:
+        // JR
+        follow(entry.bank, end + (signed char)last->arg);
+        break;
+    case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA:
+    case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC:
+        // JP and CALL
+        follow(entry.bank, last->arg);
+        break;
+    case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+        // RST
+        follow(entry.bank, opcode & 0x38);
+        break;
+    }
+
+    // everything but unconditional jumps and returns continues after the block, calls once they return
+    if (opcode != 0x18 && opcode != 0xC3 && opcode != 0xC9 && opcode != 0xD9 && opcode != 0xE9)
+        follow(entry.bank, end);
+}
+
+static int compare(const void *a, const void *b) {
+    const Entry *x = a, *y = b;
+    if (x->bank != y->bank)
+        return x->bank - y->bank;
+    return x->pc - y->pc;
+}
+
+// helpers of the generated code, they do what the static ones in instructions.c and cb.c do
+static const char *helpers =
+    "\n"
+    "static inline unsigned char load(Gameboy *gb, unsigned short addr) {\n"
+    "    unsigned char *page = gb->map.read[addr >> 8];\n"
+    "    return page != NULL ? page[addr & 0xFF] : read_mmu(gb, addr);\n"
+    "}\n"
+    "\n"
+    "static inline void store(Gameboy *gb, unsigned short addr, unsigned char value) {\n"
+    "    unsigned char *page = gb->map.write[addr >> 8];\n"
+    "    if (page != NULL)\n"
+    "        page[addr & 0xFF] = value;\n"
+    "    else\n"
+    "        write_mmu(gb, addr, value);\n"
+    "}\n"
+    "\n"
+    "static inline void add(Cpu *cpu, unsigned char b, bool carry) {\n"
+    "    unsigned char a = cpu->A;\n"
+    "    cpu->A = a + b + carry;\n"
+    "    set_result(cpu, cpu->A);\n"
+    "    set_flag_N(cpu, false);\n"
+    "    set_half_carry(cpu, HALF_ADD, a, b, carry);\n"
+    "    set_flag_C(cpu, a + b + carry > 0xFF);\n"
+    "}\n"
+    "\n"
+    "static inline void sub(Cpu *cpu, unsigned char b, bool carry, bool compare) {\n"
+    "    unsigned char a = cpu->A, res = a - b - carry;\n"
+    "    set_result(cpu, res);\n"
+    "    set_flag_N(cpu, true);\n"
+    "    set_half_carry(cpu, HALF_SUB, a, b, carry);\n"
+    "    set_flag_C(cpu, a < b + carry);\n"
+    "    if (!compare)\n"
+    "        cpu->A = res;\n"
+    "}\n"
+    "\n"
+    "static inline void logic(Cpu *cpu, unsigned char res, bool half) {\n"
+    "    cpu->A = res;\n"
+    "    set_result(cpu, res);\n"
+    "    set_flag_N(cpu, false);\n"
+    "    set_flag_H(cpu, half);\n"
+    "    set_flag_C(cpu, false);\n"
+    "}\n"
+    "\n"
+    "static inline void alu_add(Cpu *cpu, unsigned char b) { add(cpu, b, false); }\n"
+    "static inline void alu_adc(Cpu *cpu, unsigned char b) { add(cpu, b, flag_C(cpu)); }\n"
+    "static inline void alu_sub(Cpu *cpu, unsigned char b) { sub(cpu, b, false, false); }\n"
+    "static inline void alu_sbc(Cpu *cpu, unsigned char b) { sub(cpu, b, flag_C(cpu), false); }\n"
+    "static inline void alu_and(Cpu *cpu, unsigned char b) { logic(cpu, cpu->A & b, true); }\n"
+    "static inline void alu_xor(Cpu *cpu, unsigned char b) { logic(cpu, cpu->A ^ b, false); }\n"
+    "static inline void alu_or(Cpu *cpu, unsigned char b) { logic(cpu, cpu->A | b, false); }\n"
+    "static inline void alu_cp(Cpu *cpu, unsigned char b) { sub(cpu, b, false, true); }\n"
+    "\n"
+    "static inline void add_hl(Cpu *cpu, unsigned short b) {\n"
+    "    unsigned short a = HL(cpu);\n"
+    "    set_HL(cpu, a + b);\n"
+    "    set_flag_N(cpu, false);\n"
+    "    set_half_carry(cpu, HALF_ADD16, a, b, false);\n"
+    "    set_flag_C(cpu, a + b > 0xFFFF);\n"
+    "}\n"
+    "\n"
+    "static inline unsigned char inc(Cpu *cpu, unsigned char value) {\n"
+    "    set_half_carry(cpu, HALF_ADD, value, 1, false);\n"
+    "    set_result(cpu, ++value);\n"
+    "    set_flag_N(cpu, false);\n"
+    "    return value;\n"
+    "}\n"
+    "\n"
+    "static inline unsigned char dec(Cpu *cpu, unsigned char value) {\n"
+    "    set_half_carry(cpu, HALF_SUB, value, 1, false);\n"
+    "    set_result(cpu, --value);\n"
+    "    set_flag_N(cpu, true);\n"
+    "    return value;\n"
+    "}\n"
+    "\n"
+    "// RLC, RRC, RL, RR, SLA, SRA, SWAP and SRL\n"
+    "static inline unsigned char shift(Cpu *cpu, unsigned char op, unsigned char value) {\n"
+    "    bool c = op == 6 ? false : op & 1 ? value & 1 : value >> 7;\n"
+    "    switch (op) {\n"
+    "    case 0: value = value << 1 | c; break;\n"
+    "    case 1: value = value >> 1 | c << 7; break;\n"
+    "    case 2: value = value << 1 | flag_C(cpu); break;\n"
+    "    case 3: value = value >> 1 | flag_C(cpu) << 7; break;\n"
+    "    case 4: value = value << 1; break;\n"
+    "    case 5: value = value >> 1 | (value & 0x80); break;\n"
+    "    case 6: value = value << 4 | value >> 4; break;\n"
+    "    default: value = value >> 1;\n"
+    "    }\n"
+    "    set_result(cpu, value);\n"
+    "    set_flag_N(cpu, false);\n"
+    "    set_flag_H(cpu, false);\n"
+    "    set_flag_C(cpu, c);\n"
+    "    return value;\n"
+    "}\n"
+    "\n"
+    "static inline unsigned char bit(Cpu *cpu, unsigned char value, unsigned char i) {\n"
+    "    set_result(cpu, value >> i & 1);\n"
+    "    set_flag_N(cpu, false);\n"
+    "    set_flag_H(cpu, true);\n"
+    "    return value;\n"
+    "}\n";
+
+// the 8 bit operands in opcode order, 6 is (HL)
+static const char *registers[8] = {"gb->cpu.B", "gb->cpu.C", "gb->cpu.D", "gb->cpu.E",
+                                   "gb->cpu.H", "gb->cpu.L", "load(gb, HL(&gb->cpu))", "gb->cpu.A"};
+
+static const char *pairs[4] = {"BC", "DE", "HL", "SP"};
+
+static const char *alu[8] = {"alu_add", "alu_adc", "alu_sub", "alu_sbc", "alu_and", "alu_xor", "alu_or", "alu_cp"};
+
+// NZ, Z, NC and C of the conditional jumps
+static const char *conditions[4] = {"!flag_Z(&gb->cpu)", "flag_Z(&gb->cpu)", "!flag_C(&gb->cpu)", "flag_C(&gb->cpu)"};
+
+static void emit_store(FILE *out, unsigned char r, const char *value) {
+    if (r == 6)
+        fprintf(out, "    store(gb, HL(&gb->cpu), %s);\n", value);
+    else
+        fprintf(out, "    %s = %s;\n", registers[r], value);
+}
+
+// emits the instruction as C and returns its cycles, or 0 without emitting anything if it has to call its handler
+static unsigned char emit_native(FILE *out, Decoded *instruction) {
+    unsigned char opcode = instruction->opcode;
+    unsigned short arg = instruction->arg;
+    unsigned char dst = opcode >> 3 & 7, src = opcode & 7;
+    char value[64];
+
+    if (instruction->operand == OPERAND_CB) {
+        unsigned char r = arg & 7, bit = arg >> 3 & 7;
+        if (arg < 0x40)
+            snprintf(value, sizeof(value), "shift(&gb->cpu, %u, %s)", bit, registers[r]);
+        else if (arg < 0x80)
+            snprintf(value, sizeof(value), "bit(&gb->cpu, %s, %u)", registers[r], bit);
+        else if (arg < 0xC0)
+            snprintf(value, sizeof(value), "%s & 0x%02X", registers[r], ~(1u << bit) & 0xFF);
+        else
+            snprintf(value, sizeof(value), "%s | 0x%02X", registers[r], 1u << bit);
+        emit_store(out, r, value);
+        return 8;
+    }
+
+    if (opcode == 0x00)
+        return 4;
+
+    if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76) {
+        // LD r8,r8 and LD r8,(HL) and LD (HL),r8
+        emit_store(out, dst, registers[src]);
+        return src == 6 || dst == 6 ? 8 : 4;
+    }
+
+    if (opcode >= 0x80 && opcode < 0xC0) {
+        // ALU A,r8 and ALU A,(HL)
+        fprintf(out, "    %s(&gb->cpu, %s);\n", alu[dst], registers[src]);
+        return src == 6 ? 8 : 4;
+    }
+
+    if (opcode >= 0xC0 && src == 6 && instruction->operand == OPERAND_d8) {
+        // ALU A,d8
+        fprintf(out, "    %s(&gb->cpu, 0x%02X);\n", alu[dst], arg);
+        return 8;
+    }
+
+    if (opcode < 0x40 && (src == 4 || src == 5)) {
+        // INC r8 and DEC r8, INC (HL) and DEC (HL)
+        snprintf(value, sizeof(value), "%s(&gb->cpu, %s)", src == 5 ? "dec" : "inc", registers[dst]);
+        emit_store(out, dst, value);
+        return dst == 6 ? 12 : 8;
+    }
+
+    if (opcode < 0x40 && src == 6) {
+        // LD r8,d8 and LD (HL),d8
+        snprintf(value, sizeof(value), "0x%02X", arg);
+        emit_store(out, dst, value);
+        return dst == 6 ? 12 : 8;
+    }
+
+    switch (opcode) {
+    case 0x01:
+    case 0x11:
+    case 0x21:
+    case 0x31:
+        // LD r16,d16
+        fprintf(out, "    set_%s(&gb->cpu, 0x%04X);\n", pairs[dst >> 1], arg);
+        return 12;
+    case 0x03:
+    case 0x0B:
+    case 0x13:
+    case 0x1B:
+    case 0x23:
+    case 0x2B:
+    case 0x33:
+    case 0x3B:
+        // INC r16 and DEC r16
+        fprintf(out, "    set_%s(&gb->cpu, %s(&gb->cpu) %c 1);\n", pairs[dst >> 1], pairs[dst >> 1],
+                opcode & 8 ? '-' : '+');
+        return 8;
+    case 0x09:
+    case 0x19:
+    case 0x29:
+    case 0x39:
+        // ADD HL,r16
+        fprintf(out, "    add_hl(&gb->cpu, %s(&gb->cpu));\n", pairs[dst >> 1]);
+        return 8;
+    case 0x02:
+    case 0x12:
+        // LD (BC),A / LD (DE),A
+        fprintf(out, "    store(gb, %s(&gb->cpu), gb->cpu.A);\n", pairs[dst >> 1]);
+        return 8;
+    case 0x0A:
+    case 0x1A:
+        // LD A,(BC) / LD A,(DE)
+        fprintf(out, "    gb->cpu.A = load(gb, %s(&gb->cpu));\n", pairs[dst >> 1]);
+        return 8;
+    case 0x22:
+    case 0x32:
+        // LDI (HL),A / LDD (HL),A
+        fprintf(out, "    store(gb, HL(&gb->cpu), gb->cpu.A);\n    set_HL(&gb->cpu, HL(&gb->cpu) %c 1);\n",
+                opcode == 0x32 ? '-' : '+');
+        return 8;
+    case 0x2A:
+    case 0x3A:
+        // LDI A,(HL) / LDD A,(HL)
+        fprintf(out, "    gb->cpu.A = load(gb, HL(&gb->cpu));\n    set_HL(&gb->cpu, HL(&gb->cpu) %c 1);\n",
+                opcode == 0x3A ? '-' : '+');
+        return 8;
+    case 0xE0:
+    case 0xEA:
+        // LDH (n),A / LD (a16),A
+        fprintf(out, "    store(gb, 0x%04X, gb->cpu.A);\n", opcode == 0xE0 ? 0xFF00 + arg : arg);
+        return opcode == 0xE0 ? 12 : 16;
+    case 0xE2:
+        // LD (C),A
+        fprintf(out, "    store(gb, 0xFF00 + gb->cpu.C, gb->cpu.A);\n");
+        return 8;
+    case 0xF0:
+    case 0xFA:
+        // LDH A,(n) / LD A,(a16)
+        fprintf(out, "    gb->cpu.A = load(gb, 0x%04X);\n", opcode == 0xF0 ? 0xFF00 + arg : arg);
+        return opcode == 0xF0 ? 12 : 16;
+    case 0xF2:
+        // LD A,(C)
+        fprintf(out, "    gb->cpu.A = load(gb, 0xFF00 + gb->cpu.C);\n");
+        return 4;
+    case 0x07:
+    case 0x0F:
+    case 0x17:
+    case 0x1F:
+        // RLCA, RRCA, RLA, RRA: the CB rotation of A, but Z is always reset
+        fprintf(out, "    gb->cpu.A = shift(&gb->cpu, %u, gb->cpu.A);\n    set_flag_Z(&gb->cpu, false);\n", dst);
+        return 4;
+    case 0x2F:
+        // CPL
+        fprintf(out, "    gb->cpu.A = ~gb->cpu.A;\n    set_flag_N(&gb->cpu, true);\n    set_flag_H(&gb->cpu, true);\n");
+        return 4;
+    case 0x37:
+    case 0x3F:
+        // SCF / CCF
+        fprintf(out, "    set_flag_C(&gb->cpu, %s);\n    set_flag_N(&gb->cpu, false);\n    set_flag_H(&gb->cpu, false);\n",
+                opcode == 0x37 ? "true" : "!flag_C(&gb->cpu)");
+        return 4;
+    case 0xF3:
+    case 0xFB:
+        // DI / EI
+        fprintf(out, "    gb->cpu.ime = %s;\n", opcode == 0xFB ? "true" : "false");
+        return 4;
+    }
+
+    return 0;
+}
+
+// target of the JR or JP that ends a block at next, -1 for any other instruction
+static int jump_target(Decoded *instruction, unsigned short next) {
+    unsigned char opcode = instruction->opcode;
+
+    if (instruction->operand == OPERAND_CB)
+        return -1;
+    if (opcode == 0x18 || (opcode & 0xE7) == 0x20)
+        return (unsigned short)(next + (signed char)instruction->arg);
+    if (opcode == 0xC3 || (opcode & 0xE7) == 0xC2)
+        return instruction->arg;
+    return -1;
+}
+
+static void emit_jump(FILE *out, Entry entry, Decoded *instruction, unsigned short next) {
+    unsigned char opcode = instruction->opcode;
+    unsigned short target = jump_target(instruction, next);
+    bool relative = opcode < 0x40, conditional = opcode != 0x18 && opcode != 0xC3;
+    const char *indent = conditional ? "        " : "    ";
+
+    if (conditional)
+        fprintf(out, "    if (%s) {\n", conditions[opcode >> 3 & 3]);
+    fprintf(out, "%sgb->scheduler.now += %u;\n", indent, relative ? 12 : 16);
+
+    if (target == entry.pc) {
+        // runs the block again right away, unless next_instructions would do something else first
+        fprintf(out, "%sif (gb->scheduler.now < gb->scheduler.next && !(gb->cpu.pending && gb->cpu.ime)", indent);
+        if (entry.bank != 0)
+            fprintf(out, " && gb->mmu.mbc.rom_bank_number == 0x%02X", entry.bank);
+        fprintf(out, ")\n%s    goto start;\n", indent);
+    }
+
+    fprintf(out, "%sgb->cpu.PC = 0x%04X;\n", indent, target);
+    if (conditional) {
+        fprintf(out, "        return;\n    }\n");
+        fprintf(out, "    gb->scheduler.now += %u;\n    gb->cpu.PC = 0x%04X;\n", relative ? 8 : 12, next);
+    }
+}
+
+static void emit_block(FILE *out, Entry entry) {
+    Block block;
+    decode(entry, &block);
+
+    unsigned short end = entry.pc;
+    for (unsigned char i = 0; i < block.count; i++)
+        end += block.instructions[i].length;
+
+    Decoded *last = &block.instructions[block.count - 1];
+
+    fprintf(out, "\nstatic void block_%02X_%04X(Gameboy *gb) {\n", entry.bank, entry.pc);
+    if (jump_target(last, end) == entry.pc)
+        fprintf(out, "start:\n");
+
+    // handlers see the PC of the next instruction, other instructions only store it on the way out
+    unsigned short pc = entry.pc;
+    bool stored = false;
+    for (unsigned char i = 0; i < block.count; i++) {
+        Decoded *instruction = &block.instructions[i];
+
+        if (i > 0) {
+            fprintf(out, "    if (gb->scheduler.now >= gb->scheduler.next || gb->cpu.pending");
+            if (entry.bank != 0)
+                fprintf(out, " || gb->mmu.mbc.rom_bank_number != 0x%02X", entry.bank);
+            fprintf(out, ") {\n        gb->cpu.PC = 0x%04X;\n        return;\n    }\n", pc);
+        }
+
+        pc += instruction->length;
+
+        if (instruction == last && jump_target(instruction, pc) >= 0) {
+            emit_jump(out, entry, instruction, pc);
+            stored = true;
+            break;
+        }
+
+        unsigned char cycles = emit_native(out, instruction);
+        if (cycles > 0) {
+            fprintf(out, "    gb->scheduler.now += %u;\n", cycles);
+            stored = false;
+            continue;
+        }
+
+        fprintf(out, "    gb->cpu.PC = 0x%04X;\n", pc);
+        switch (instruction->operand) {
+        case OPERAND_d8:
+            fprintf(out, "    gb->scheduler.now += %s(gb, 0x%02X);\n", names[instruction->opcode], instruction->arg);
+            break;
+        case OPERAND_d16:
+            fprintf(out, "    gb->scheduler.now += %s(gb, 0x%04X);\n", names[instruction->opcode], instruction->arg);
+            break;
+        default:
+            fprintf(out, "    gb->scheduler.now += %s(gb);\n", names[instruction->opcode]);
+        }
+        stored = true;
+    }
+
+    if (!stored)
+        fprintf(out, "    gb->cpu.PC = 0x%04X;\n", end);
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 4) {
+        puts("Usage: cboy-aot <rom> <output.c> <table name>");
+        exit(1);
+    }
+
+    load_rom(&gameboy, argv[1]);
+
+    // the banks map_rom found in the file and its header, bank numbers are 8 bit here
+    banks = gameboy.mmu.mbc.rom_banks < 0x100 ? gameboy.mmu.mbc.rom_banks : 0x100;
+
+    push(0, 0x100);
+    for (unsigned short vector = 0; vector <= 0x60; vector += 8)
+        push(0, vector);
+
+    for (unsigned int i = 0; i < count; i++)
+        walk(entries[i]);
+
+    // targets without any instruction are left to the interpreter
+    Block block;
+    unsigned int found = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        if (decode(entries[i], &block))
+            entries[found++] = entries[i];
+    }
+    count = found;
+
+    qsort(entries, count, sizeof(Entry), compare);
+
+    FILE *out = fopen(argv[2], "w");
+    if (!out) {
+        printf("Error writing %s!\n", argv[2]);
+        exit(1);
+    }
+
+    fprintf(out, "// generated by cboy-aot from %s\n\n", argv[1]);
+    fprintf(out, "#include \"gameboy.h\"\n#include \"instructions/instructions.h\"\n");
+    fputs(helpers, out);
+
+    for (unsigned int i = 0; i < count; i++)
+        emit_block(out, entries[i]);
+
+    fprintf(out, "\nstatic const AotBlock blocks[] = {\n");
+    for (unsigned int i = 0; i < count; i++)
+        fprintf(out, "    {0x%02X, 0x%04X, block_%02X_%04X},\n", entries[i].bank, entries[i].pc, entries[i].bank,
+                entries[i].pc);
+    fprintf(out, "};\n");
+
+    fprintf(out, "\nconst AotTable %s = {blocks, %u, 0x%02X%02X};\n", argv[3], count, gameboy.mmu.mbc.rom[0x14E],
+            gameboy.mmu.mbc.rom[0x14F]);
+
+    fclose(out);
+    printf("%u blocks\n", count);
+
+    return 0;
+}
\ No newline at end of file
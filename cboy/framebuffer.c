@@ -3,13 +3,18 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <linux/fb.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
-#include <time.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
-#include <cpu.h>
-#include <display.h>
+#include <gameboy.h>
+
+#include "joystick.h"
 
 #define WIDTH 160
 #define HEIGHT 144
@@ -19,63 +24,219 @@ struct fb_var_screeninfo vinfo;
 uint8_t *fbp;
 
 unsigned char scale = 1;
-int x_offset = 0;
+unsigned int x_offset = 0;
+
+// the screen as it was before double_buffer resized it, restored on exit
+static struct fb_var_screeninfo original;
+static int resized = -1;
+
+// the frame in the pixel format of the framebuffer when it has to be scaled up, XRGB8888 when converted
+uint32_t frame[HEIGHT][WIDTH];
+
+static bool matches(const struct fb_bitfield *field, unsigned int offset, unsigned int length) {
+    return field->offset == offset && field->length == length && field->msb_right == 0;
+}
+
+// the layout of the framebuffer if libcboy can draw it directly, otherwise frames are converted by blit
+static bool native_format(PixelFormat *format) {
+    if (vinfo.bits_per_pixel == 16 && matches(&vinfo.red, 11, 5) && matches(&vinfo.green, 5, 6) &&
+        matches(&vinfo.blue, 0, 5)) {
+        *format = PIXEL_RGB565;
+        return true;
+    }
+    if (vinfo.bits_per_pixel == 32 && matches(&vinfo.red, 16, 8) && matches(&vinfo.green, 8, 8) &&
+        matches(&vinfo.blue, 0, 8)) {
+        *format = PIXEL_XRGB8888;
+        return true;
+    }
+    return false;
+}
+
+// any other truecolor layout of up to 8 bits per channel, e.g. BGR or 24 bit, can be packed from XRGB8888
+static bool convertible(void) {
+    const struct fb_bitfield *fields[] = {&vinfo.red, &vinfo.green, &vinfo.blue, &vinfo.transp};
+    unsigned int bits = vinfo.bits_per_pixel;
+    if (finfo.visual != FB_VISUAL_TRUECOLOR || bits % 8 != 0 || bits < 16 || bits > 32)
+        return false;
+    for (unsigned char i = 0; i < 4; i++) {
+        if (fields[i]->length > 8 || fields[i]->msb_right != 0 || fields[i]->offset + fields[i]->length > bits)
+            return false;
+    }
+    return true;
+}
 
-static void draw_pixel_rgb(uint32_t x, uint32_t y, uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
-    uint32_t pixel =
-        (r << vinfo.red.offset) | (g << vinfo.green.offset) | (b << vinfo.blue.offset) | (a << vinfo.transp.offset);
-    uint32_t location = x * vinfo.bits_per_pixel / 8 + y * finfo.line_length;
-    *((uint32_t *)(fbp + location)) = pixel;
+// a 0xFFRRGGBB pixel in the layout vinfo describes, the transparency bits (if any) are set to opaque
+static uint32_t pack(uint32_t pixel) {
+    uint32_t red = pixel >> 16 & 0xFF, green = pixel >> 8 & 0xFF, blue = pixel & 0xFF;
+    return red >> (8 - vinfo.red.length) << vinfo.red.offset | green >> (8 - vinfo.green.length) << vinfo.green.offset |
+           blue >> (8 - vinfo.blue.length) << vinfo.blue.offset |
+           ((1u << vinfo.transp.length) - 1) << vinfo.transp.offset;
 }
 
-static void draw_pixel(unsigned char x, unsigned char y, unsigned short color) {
-    for (unsigned char px = 0; px < scale; px++) {
-        for (unsigned char py = 0; py < scale; py++) {
-            draw_pixel_rgb(x * scale + px + x_offset, y * scale + py, (color & 0x1f) * 8, ((color >> 5) & 0x1f) * 8, ((color >> 10) & 0x1f) * 8, 0);
+// scales the frame up into the screen at screen, every pixel of a line is repeated and the line copied
+static void blit(uint8_t *screen, unsigned int bytes, bool convert) {
+    for (unsigned char y = 0; y < HEIGHT; y++) {
+        uint8_t *line = screen + y * scale * finfo.line_length + x_offset * bytes;
+
+        if (convert) {
+            // stored as the low bytes of the value, the framebuffer is in host byte order
+            uint8_t *dst = line;
+            for (unsigned char x = 0; x < WIDTH; x++) {
+                uint32_t pixel = pack(frame[y][x]);
+                for (unsigned char px = 0; px < scale; px++, dst += bytes)
+                    memcpy(dst, &pixel, bytes);
+            }
+        } else if (bytes == 2) {
+            const uint16_t *src = (const uint16_t *)frame + y * WIDTH;
+            uint16_t *dst = (uint16_t *)line;
+            for (unsigned char x = 0; x < WIDTH; x++, dst += scale) {
+                for (unsigned char px = 0; px < scale; px++)
+                    dst[px] = src[x];
+            }
+        } else {
+            const uint32_t *src = frame[y];
+            uint32_t *dst = (uint32_t *)line;
+            for (unsigned char x = 0; x < WIDTH; x++, dst += scale) {
+                for (unsigned char px = 0; px < scale; px++)
+                    dst[px] = src[x];
+            }
         }
+
+        for (unsigned char py = 1; py < scale; py++)
+            memcpy(line + py * finfo.line_length, line, WIDTH * scale * bytes);
+    }
+}
+
+// a plain file stands in for the framebuffer, e.g. to run without a display, taken as 640x480 XRGB8888
+static void fake_screen(int fd, const char *path) {
+    memset(&vinfo, 0, sizeof(vinfo));
+    memset(&finfo, 0, sizeof(finfo));
+    vinfo.xres = vinfo.xres_virtual = 640;
+    vinfo.yres = vinfo.yres_virtual = 480;
+    vinfo.bits_per_pixel = 32;
+    vinfo.red = (struct fb_bitfield){16, 8, 0};
+    vinfo.green = (struct fb_bitfield){8, 8, 0};
+    vinfo.blue = (struct fb_bitfield){0, 8, 0};
+    finfo.visual = FB_VISUAL_TRUECOLOR;
+    finfo.line_length = vinfo.xres * 4;
+
+    // a file shorter than the screen would fault on the first frame drawn past its end
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        (st.st_size < vinfo.yres * finfo.line_length && ftruncate(fd, vinfo.yres * finfo.line_length) != 0)) {
+        perror(path);
+        exit(1);
+    }
+}
+
+// only calls ioctl, so it can run in a signal handler
+static void restore_screen(void) {
+    if (resized >= 0)
+        ioctl(resized, FBIOPUT_VSCREENINFO, &original);
+}
+
+static void restore_on_signal(int signal_number) {
+    restore_screen();
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+// asks for a second screen below the visible one, frames are drawn into the hidden one and panned to
+static bool double_buffer(int fd) {
+    original = vinfo;
+    resized = fd;
+    atexit(restore_screen);
+    signal(SIGINT, restore_on_signal);
+    signal(SIGTERM, restore_on_signal);
+
+    if (vinfo.yres_virtual < vinfo.yres * 2) {
+        struct fb_var_screeninfo virtual = vinfo;
+        virtual.yres_virtual = vinfo.yres * 2;
+        virtual.yoffset = 0;
+        if (ioctl(fd, FBIOPUT_VSCREENINFO, &virtual) != 0)
+            return false;
+
+        ioctl(fd, FBIOGET_VSCREENINFO, &vinfo);
+        ioctl(fd, FBIOGET_FSCREENINFO, &finfo);
     }
+
+    return vinfo.yres_virtual >= vinfo.yres * 2 && finfo.smem_len >= vinfo.yres * 2 * finfo.line_length;
 }
 
-void display_loop() {
-    int fd = open("/dev/fb0", O_RDWR);
-    ioctl(fd, FBIOGET_VSCREENINFO, &vinfo);
-    ioctl(fd, FBIOGET_FSCREENINFO, &finfo);
+void display_loop(Gameboy *gb) {
+    // FRAMEBUFFER selects another device, or a file that is created if it does not exist
+    const char *path = getenv("FRAMEBUFFER");
+    int fd = path != NULL ? open(path, O_RDWR | O_CREAT, 0644) : open(path = "/dev/fb0", O_RDWR);
+    if (fd < 0) {
+        perror(path);
+        exit(1);
+    }
 
-    size_t size = vinfo.yres * finfo.line_length;
+    struct stat st;
+    bool pan = false;
+    if (ioctl(fd, FBIOGET_VSCREENINFO, &vinfo) == 0 && ioctl(fd, FBIOGET_FSCREENINFO, &finfo) == 0) {
+        pan = double_buffer(fd);
+    } else if (getenv("FRAMEBUFFER") != NULL && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        fake_screen(fd, path);
+    } else {
+        fprintf(stderr, "%s is not a framebuffer\n", path);
+        exit(1);
+    }
 
-    scale = vinfo.yres / HEIGHT;
+    size_t size = (pan ? 2 : 1) * vinfo.yres * finfo.line_length;
+
+    // the largest integer scale that fits both ways
+    scale = vinfo.xres / WIDTH < vinfo.yres / HEIGHT ? vinfo.xres / WIDTH : vinfo.yres / HEIGHT;
+    if (scale == 0) {
+        fprintf(stderr, "%s is smaller than %dx%d\n", path, WIDTH, HEIGHT);
+        exit(1);
+    }
     x_offset = (vinfo.xres - WIDTH * scale) / 2;
 
     fbp = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (fbp == MAP_FAILED) {
+        perror(path);
+        exit(1);
+    }
+
+    // RGB565 and XRGB8888 are drawn directly, other truecolor layouts are converted from XRGB8888
+    unsigned int bytes = vinfo.bits_per_pixel / 8;
+    PixelFormat format = PIXEL_XRGB8888;
+    bool convert = !native_format(&format);
+    if (convert && !convertible()) {
+        fprintf(stderr, "%s: unsupported pixel format, %" PRIu32 " bits per pixel\n", path, vinfo.bits_per_pixel);
+        exit(1);
+    }
 
-    Frame buffer;
+    // the screen drawn next, the hidden one while panning
+    unsigned int page = pan ? 1 : 0;
 
-    int frames = 60;
-    int throttle = 0;
-    time_t last_time = 0;
+    // without a display server nothing else waits for the screen, wake up early and spin for the last ms
+    Pacer pacer;
+    init_pacer(&pacer);
+    pacer.spin = 1000000;
 
     while (true) {
+        run_joystick_requests(gb);
 
-        buffer = next_frame();
+        uint8_t *screen = fbp + page * vinfo.yres * finfo.line_length;
 
-        for (unsigned char y = 0; y < HEIGHT; y++) {
-            for (unsigned char x = 0; x < WIDTH; x++) {
-                draw_pixel(x, y, buffer.buffer[y][x]);
-            }
-        }
+        if (scale == 1 && !convert)
+            set_frame_output(gb, screen + x_offset * bytes, finfo.line_length, format);
+        else
+            set_frame_output(gb, frame, WIDTH * (convert ? 4 : bytes), format);
 
-        frames++;
-        if (time(NULL) > last_time) {
-            time(&last_time);
-            if (throttle == 0) {
-                throttle = frames;
-            } else {
-                throttle = throttle * ((float)frames / 60);
-            }
-            frames = 0;
-        }
-        if (throttle > 60) {
-            usleep(1000000 * ((1 - (float)60 / throttle)) / 60);
+        next_frame(gb);
+
+        if (scale > 1 || convert)
+            blit(screen, bytes, convert);
+
+        if (pan) {
+            vinfo.yoffset = page * vinfo.yres;
+            ioctl(fd, FBIOPAN_DISPLAY, &vinfo);
+            page ^= 1;
         }
+
+        pace_frame(&pacer);
     }
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <fcntl.h>
 #include <linux/joystick.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <unistd.h>
 
@@ -11,6 +12,10 @@
 
 int js_dev = -1;
 
+// the display loop owns the emulation, states are only loaded and saved there between frames
+enum { NO_REQUEST, LOAD_STATE, SAVE_STATE };
+static atomic_int request;
+
 static int read_event(int fd, struct js_event *event) {
     ssize_t bytes;
 
@@ -22,42 +27,43 @@ static int read_event(int fd, struct js_event *event) {
     return -1;
 }
 
-void *joystick_thread() {
+void *joystick_thread(void *arg) {
+    Gameboy *gb = arg;
     struct js_event event;
 
     while (read_event(js_dev, &event) == 0) {
         if (event.type == JS_EVENT_BUTTON) {
-            void (*fun)(unsigned char) = event.value ? press : release;
+            void (*fun)(Gameboy *, unsigned char) = event.value ? press : release;
             switch (event.number) {
                 case 12:
-                    fun(RIGHT);
+                    fun(gb, RIGHT);
                     break;
                 case 11:
-                    fun(LEFT);
+                    fun(gb, LEFT);
                     break;
                 case 13:
-                    fun(UP);
+                    fun(gb, UP);
                     break;
                 case 14:
-                    fun(DOWN);
+                    fun(gb, DOWN);
                     break;
                 case 0:
-                    fun(CBOY_KEY_A);
+                    fun(gb, CBOY_KEY_A);
                     break;
                 case 1:
-                    fun(CBOY_KEY_B);
+                    fun(gb, CBOY_KEY_B);
                     break;
                 case 6:
-                    fun(SELECT);
+                    fun(gb, SELECT);
                     break;
                 case 7:
-                    fun(START);
+                    fun(gb, START);
                     break;
                 case 4:
-                    load_state();
+                    atomic_store(&request, LOAD_STATE);
                     break;
                 case 5:
-                    save_state();
+                    atomic_store(&request, SAVE_STATE);
                     break;
             }
         }
@@ -66,12 +72,23 @@ void *joystick_thread() {
     return NULL;
 }
 
-void init_joystick() {
+void run_joystick_requests(Gameboy *gb) {
+    switch (atomic_exchange(&request, NO_REQUEST)) {
+        case LOAD_STATE:
+            load_state(gb);
+            break;
+        case SAVE_STATE:
+            save_state(gb);
+            break;
+    }
+}
+
+void init_joystick(Gameboy *gb) {
     js_dev = open("/dev/input/js0", O_RDONLY);
 
     if (js_dev == -1)
         perror("Could not open joystick");
 
     pthread_t thread_id;
-    pthread_create(&thread_id, NULL, joystick_thread, NULL);
+    pthread_create(&thread_id, NULL, joystick_thread, gb);
 }
\ No newline at end of file
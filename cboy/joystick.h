@@ -3,6 +3,11 @@
 #ifndef CBOY_JOYSTICK_H
 #define CBOY_JOYSTICK_H
 
-void init_joystick();
+typedef struct Gameboy Gameboy;
+
+void init_joystick(Gameboy *gb);
+
+// loads or saves the state when the joystick asked for it, called by the display loop between frames
+void run_joystick_requests(Gameboy *gb);
 
 #endif // CBOY_JOYSTICK_H
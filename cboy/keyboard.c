@@ -10,31 +10,39 @@
 #include <display.h>
 #include <gameboy.h>
 
-static void handle_key(int key, void (*function)(unsigned char)) {
+static Gameboy *gameboy;
+static Pacer *pacer;
+
+void init_keyboard(Gameboy *gb, Pacer *p) {
+    gameboy = gb;
+    pacer = p;
+}
+
+static void handle_key(int key, void (*function)(Gameboy *, unsigned char)) {
     switch (key) {
         case GLUT_KEY_RIGHT:
-            function(RIGHT);
+            function(gameboy, RIGHT);
             break;
         case GLUT_KEY_LEFT:
-            function(LEFT);
+            function(gameboy, LEFT);
             break;
         case GLUT_KEY_UP:
-            function(UP);
+            function(gameboy, UP);
             break;
         case GLUT_KEY_DOWN:
-            function(DOWN);
+            function(gameboy, DOWN);
             break;
         case 'a':
-            function(CBOY_KEY_A);
+            function(gameboy, CBOY_KEY_A);
             break;
         case 's':
-            function(CBOY_KEY_B);
+            function(gameboy, CBOY_KEY_B);
             break;
         case 'q':
-            function(START);
+            function(gameboy, START);
             break;
         case 'w':
-            function(SELECT);
+            function(gameboy, SELECT);
             break;
     }
 }
@@ -45,19 +53,30 @@ void special_key_handler(int key, int x, int y) {
 
 void special_key_up_handler(int key, int x, int y) {
     if (key == GLUT_KEY_F5)
-        load_state();
+        load_state(gameboy);
     else if (key == GLUT_KEY_F6)
-        save_state();
+        save_state(gameboy);
     else if (key == GLUT_KEY_F11)
         toggle_fullscreen();
+    else if (key == GLUT_KEY_F7) {
+        pacer_report(pacer, stderr);
+        reset_pacer_stats(pacer);
+    } else if (key == GLUT_KEY_F8)
+        set_pacer_speed(pacer, pacer->speed == 1 ? 0.5 : 1);
     else
         handle_key(key, release);
 }
 
 void normal_key_handler(unsigned char key, int x, int y) {
-    handle_key(key, press);
+    if (key == '\t')
+        set_pacer_speed(pacer, 0);
+    else
+        handle_key(key, press);
 }
 
 void normal_key_up_handler(unsigned char key, int x, int y) {
-    handle_key(key, release);
+    if (key == '\t')
+        set_pacer_speed(pacer, 1);
+    else
+        handle_key(key, release);
 }
\ No newline at end of file
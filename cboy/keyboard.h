@@ -3,6 +3,12 @@
 #ifndef CBOY_KEYBOARD_H
 #define CBOY_KEYBOARD_H
 
+typedef struct Gameboy Gameboy;
+typedef struct Pacer Pacer;
+
+// Tab runs unthrottled while held, F8 toggles slow motion and F7 writes the frame times to stderr
+void init_keyboard(Gameboy *gb, Pacer *p);
+
 void special_key_handler(int key, int x, int y);
 
 void special_key_up_handler(int key, int x, int y);
@@ -2,6 +2,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef __APPLE__
 #include <GLUT/glut.h>
@@ -16,19 +17,34 @@
 #include "joystick.h"
 #endif
 
+static Gameboy gameboy;
+
+#ifdef PROFILE
+static void report(void) { profile_report(&gameboy, stderr, 32); }
+#endif
+
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
+    // -p draws the frames on a second thread
+    bool pipelined = argc == 3 && strcmp(argv[1], "-p") == 0;
+
+    if (argc != 2 && !pipelined) {
         puts("No rom file specified");
         exit(1);
     }
 
+    load_rom(&gameboy, argv[argc - 1]);
+    if (pipelined && !start_pipeline(&gameboy))
+        puts("Drawing on the emulation thread");
+#ifdef PROFILE
+    atexit(report);
+#endif
 #ifdef linux
-    init_joystick();
+    init_joystick(&gameboy);
 #endif
-    load_rom(argv[1]);
-    display_loop();
+    display_loop(&gameboy);
 }
 
-void serial_print(char c) {
+void serial_print(Gameboy *gb, char c) {
+    (void)gb;
     printf("%c", c);
 }
\ No newline at end of file
@@ -8,10 +8,14 @@
 #include <GL/glut.h>
 #endif
 
-#include <cpu.h>
+#include <gameboy.h>
 
 #include "keyboard.h"
 
+#ifdef linux
+#include "joystick.h"
+#endif
+
 #define WIDTH 160
 #define HEIGHT 144
 
@@ -20,16 +24,11 @@ int window_height = HEIGHT;
 
 bool fullscreen = false;
 
-Frame buffer;
+static Gameboy *gameboy;
+static Pacer pacer;
 
-
-static void draw_pixel(unsigned char x, unsigned char y, unsigned short color) {
-    glPointSize(window_width / (float)WIDTH);
-    glBegin(GL_POINTS);
-    glColor3f((float)(color & 0x1f) / 32, (float)((color >> 5) & 0x1f) / 32, (float)((color >> 10) & 0x1f) / 32);
-    glVertex2i(x, y);
-    glEnd();
-}
+// the RGBA8888 frame, drawn into by the emulator
+static unsigned char pixels[HEIGHT][WIDTH][4];
 
 static void display() {
     window_width = glutGet(GLUT_WINDOW_WIDTH);
@@ -40,21 +39,29 @@ static void display() {
                window_height);
     glOrtho(0.0f, WIDTH, HEIGHT, 0.0f, 0.0f, 1.0f);
 
-    for (unsigned char y = 0; y < HEIGHT; y++) {
-        for (unsigned char x = 0; x < WIDTH; x++) {
-            draw_pixel(x, y, buffer.buffer[y][x]);
-        }
-    }
+    // the first line is the top one, draw downwards from the top left corner
+    glRasterPos2i(0, 0);
+    glPixelZoom((float)window_height / HEIGHT, -(float)window_height / HEIGHT);
+    glDrawPixels(WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
 
     glutSwapBuffers();
 }
 
 static void idle_func() {
-    buffer = next_frame();
+#ifdef linux
+    run_joystick_requests(gameboy);
+#endif
+    next_frame(gameboy);
+    pace_frame(&pacer);
     glutPostRedisplay();
 }
 
-void display_loop() {
+void display_loop(Gameboy *gb) {
+    gameboy = gb;
+    init_pacer(&pacer);
+    init_keyboard(gb, &pacer);
+    set_frame_output(gb, pixels, sizeof(pixels[0]), PIXEL_RGBA8888);
+
     int argc = 0;
     glutInit(&argc, 0);
     glutInitDisplayMode(GL_DOUBLE);
@@ -3,6 +3,8 @@
 #ifndef CBOY_RENDER_H
 #define CBOY_RENDER_H
 
-void display_loop();
+typedef struct Gameboy Gameboy;
+
+void display_loop(Gameboy *gb);
 
 #endif // CBOY_RENDER_H
\ No newline at end of file
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifdef AOT
+
+#include <stdio.h>
+#include <string.h>
+
+#include "gameboy.h"
+
+bool load_aot(Gameboy *gb, const AotTable *table) {
+    // 014E-014F - Global Checksum
+    unsigned short checksum = (gb->mmu.mbc.rom[0x14E] << 8) | gb->mmu.mbc.rom[0x14F];
+    if (table->checksum != checksum) {
+        printf("AOT table does not match the ROM!\n");
+        return false;
+    }
+
+    gb->aot = table;
+
+    // blocks in ROM never get invalidated, decode them again to pick up the translated code
+    memset(gb->cache.blocks, 0, sizeof(gb->cache.blocks));
+    return true;
+}
+
+Compiled aot_lookup(const AotTable *table, unsigned char bank, unsigned short pc) {
+    unsigned int low = 0;
+    unsigned int high = table->count;
+
+    while (low < high) {
+        unsigned int middle = (low + high) / 2;
+        const AotBlock *block = &table->blocks[middle];
+
+        if (block->bank == bank && block->pc == pc)
+            return block->code;
+
+        if (block->bank < bank || (block->bank == bank && block->pc < pc))
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return NULL;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIBCBOY_AOT_H
+#define LIBCBOY_AOT_H
+
+#include <stdbool.h>
+
+#include "cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    unsigned char bank; // 0 for 0000-3FFF
+    unsigned short pc;
+    Compiled code;
+} AotBlock;
+
+/*
+ * Blocks of one ROM translated to C by cboy-aot, sorted by bank and pc. Blocks that were not
+ * found statically, like targets of JP HL or code in RAM, keep running in the interpreter.
+ */
+typedef struct {
+    const AotBlock *blocks;
+    unsigned int count;
+    unsigned short checksum; // global checksum from the cartridge header
+} AotTable;
+
+/*
+ * Runs the translated blocks of table for the loaded ROM, false if the table was generated from a
+ * different ROM.
+ */
+bool load_aot(Gameboy *gb, const AotTable *table);
+
+Compiled aot_lookup(const AotTable *table, unsigned char bank, unsigned short pc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCBOY_AOT_H
\ No newline at end of file
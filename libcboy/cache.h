@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIBCBOY_CACHE_H
+#define LIBCBOY_CACHE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Gameboy Gameboy;
+
+#define BLOCK_CACHE_SIZE 1024
+#define BLOCK_LENGTH 16
+
+// how the handler of a decoded instruction is called
+enum { OPERAND_NONE, OPERAND_d8, OPERAND_d16, OPERAND_CB };
+
+// the handler of an instruction, by its operand
+typedef union {
+    unsigned char (*none)(Gameboy *gb);
+    unsigned char (*d8)(Gameboy *gb, unsigned char value);
+    unsigned char (*d16)(Gameboy *gb, unsigned short value);
+    void (*cb)(Gameboy *gb);
+} Handler;
+
+typedef struct {
+    Handler handler;
+    unsigned short arg; // the operand, or the opcode that follows CB
+    unsigned char opcode;
+    unsigned char length; // in bytes, including opcode and prefix
+    unsigned char operand;
+} Decoded;
+
+/*
+ * Native code of a block, compiled by jit.c or generated ahead of time by cboy-aot. Runs like run_block in cpu.c.
+ */
+typedef void (*Compiled)(Gameboy *gb);
+
+/*
+ * Basic block: straight line code up to and including the first jump, call, return or HALT.
+ *
+ * Blocks from 0000-3FFF are valid for as long as the ROM is loaded, blocks from 4000-7FFF only while the
+ * ROM bank they were decoded from is mapped. Blocks in RAM stay valid until the generation of the cache
+ * is bumped by a write to one of their bytes or a WRAM bank switch.
+ */
+typedef struct {
+    unsigned short pc;
+    unsigned char bank;
+    unsigned char count; // number of instructions, 0 for an empty slot
+    unsigned int generation;
+#ifdef JIT
+    unsigned int hits;
+#endif
+#if defined(JIT) || defined(AOT)
+    Compiled code; // NULL while interpreted
+#endif
+    Decoded instructions[BLOCK_LENGTH];
+} Block;
+
+typedef struct {
+    unsigned int generation;
+    unsigned char code[0x8000 / 8]; // one bit for every byte of 8000-FFFF that belongs to a cached block
+    Block blocks[BLOCK_CACHE_SIZE];
+} Cache;
+
+void invalidate_blocks(Gameboy *gb);
+
+// decodes the block at pc, ROM bank is the one mapped to 4000-7FFF for code in there
+Block *decode_block(Gameboy *gb, Block *block, unsigned short pc, unsigned char bank);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCBOY_CACHE_H
\ No newline at end of file
@@ -2,8 +2,8 @@
 
 #include "gameboy.h"
 
-void press(unsigned char i) { gameboy.controls &= ~(1 << i); }
+void press(Gameboy *gb, unsigned char i) { gb->controls &= ~(1 << i); }
 
-void release(unsigned char i) { gameboy.controls |= (1 << i); }
+void release(Gameboy *gb, unsigned char i) { gb->controls |= (1 << i); }
 
-void release_all() { gameboy.controls = 0xFF; }
\ No newline at end of file
+void release_all(Gameboy *gb) { gb->controls = 0xFF; }
\ No newline at end of file
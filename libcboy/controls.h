@@ -17,11 +17,13 @@ extern "C" {
 #define SELECT 6
 #define START 7
 
-void press(unsigned char i);
+typedef struct Gameboy Gameboy;
 
-void release(unsigned char i);
+void press(Gameboy *gb, unsigned char i);
 
-void release_all();
+void release(Gameboy *gb, unsigned char i);
+
+void release_all(Gameboy *gb);
 
 #ifdef __cplusplus
 }
@@ -1,69 +1,37 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "display.h"
 #include "gameboy.h"
-#include "timer.h"
+#include "jit.h"
 #include "instructions/cb.h"
 #include "instructions/instructions.h"
+#include "instructions/opcodes.h"
+
+#ifndef THREADED_DISPATCH
+
+#define HANDLER(OPCODE, NAME) [OPCODE] = NAME,
+#define HANDLER_NONE(OPCODE) [OPCODE] = NOP,
+
+static const unsigned char (*opcodes[0x100])() = {OPCODES(HANDLER, HANDLER, HANDLER, HANDLER_NONE, HANDLER_NONE)};
+
+static const void (*cb[0x100])() = {CB_OPCODES(HANDLER)};
 
-Cpu cpu =  {.SP = 0xFFFF,
-            .ime = true,
-            .halt = false};
-
-static const unsigned char (*opcodes[0x100])() = {NOP, LD_BC_d16, LD_BC_A, INC_BC, INC_B, DEC_B, LD_B_d8, RLCA, LD_a16_SP, ADD_HL_BC, LD_A_BC, DEC_BC, INC_C, DEC_C, LD_C_d8, RRCA,
-        NOP, LD_DE_d16, LD_DE_A, INC_DE, INC_D, DEC_D, LD_D_d8, RLA, JR_r8, ADD_HL_DE, LD_A_DE, DEC_DE, INC_E, DEC_E, LD_E_d8, RRA,
-        JR_NZ_r8, LD_HL_d16, LDI_HL_A, INC_HL, INC_H, DEC_H, LD_H_d8, DAA, JR_Z_r8, ADD_HL_HL, LDI_A_HL, DEC_HL, INC_L, DEC_L, LD_L_d8, CPL,
-        JR_NC_r8, LD_SP_d16, LDD_HL_A, INC_SP, INC_HLp, DEC_HLp, LD_HLp_d8, SCF, JR_C_r8, ADD_HL_SP, LDD_A_HL, DEC_SP, INC_A, DEC_A, LD_A_d8, CCF,
-        LD_B_B, LD_B_C, LD_B_D, LD_B_E, LD_B_H, LD_B_L, LD_B_HLp, LD_B_A, LD_C_B, LD_C_C, LD_C_D, LD_C_E, LD_C_H, LD_C_L, LD_C_HLp, LD_C_A,
-        LD_D_B, LD_D_C, LD_D_D, LD_D_E, LD_D_H, LD_D_L, LD_D_HLp, LD_D_A, LD_E_B, LD_E_C, LD_E_D, LD_E_E, LD_E_H, LD_E_L, LD_E_HLp, LD_E_A,
-        LD_H_B, LD_H_C, LD_H_D, LD_H_E, LD_H_H, LD_H_L, LD_H_HLp, LD_H_A, LD_L_B, LD_L_C, LD_L_D, LD_L_E, LD_L_H, LD_L_L, LD_L_HLp, LD_L_A,
-        LD_HLp_B, LD_HLp_C, LD_HLp_D, LD_HLp_E, LD_HLp_H, LD_HLp_L, HALT, LD_HLp_A, LD_A_B, LD_A_C, LD_A_D, LD_A_E, LD_A_H, LD_A_L, LD_A_HLp, LD_A_A,
-        ADD_B, ADD_C, ADD_D, ADD_E, ADD_H, ADD_L, ADD_HLp, ADD_A, ADC_B, ADC_C, ADC_D, ADC_E, ADC_H, ADC_L, ADC_HLp, ADC_A,
-        SUB_B, SUB_C, SUB_D, SUB_E, SUB_H, SUB_L, SUB_HLp, SUB_A, SBC_B, SBC_C, SBC_D, SBC_E, SBC_H, SBC_L, SBC_HLp, SBC_A,
-        AND_B, AND_C, AND_D, AND_E, AND_H, AND_L, AND_HLp, AND_A, XOR_B, XOR_C, XOR_D, XOR_E, XOR_H, XOR_L, XOR_HLp, XOR_A,
-        OR_B, OR_C, OR_D, OR_E, OR_H, OR_L, OR_HLp, OR_A, CP_B, CP_C, CP_D, CP_E, CP_H, CP_L, CP_HLp, CP_A,
-        RET_NZ, POP_BC, JP_NZ_a16, JP, CALL_NZ_a16, PUSH_BC, ADD_d8, RST_0x0, RET_Z, RET, JP_Z_a16, NOP, CALL_Z_a16, CALL_a16, ADC_d8, RST_0x8,
-        RET_NC, POP_DE, JP_NC_a16, NOP, CALL_NC_a16, PUSH_DE, SUB_d8, RST_0x10, RET_C, RETI, JP_C_a16, NOP, CALL_C_a16, NOP, SBC_d8, RST_0x18,
-        LDH_n_A, POP_HL, LD_Cp_A, NOP, NOP, PUSH_HL, AND_d8, RST_0x20, ADD_SP_r8, JP_HL, LD_a16_A, NOP, NOP, NOP, XOR_d8, RST_0x28,
-        LDH_A_n, POP_AF, LD_A_Cp, DI, NOP, PUSH_AF, OR_d8, RST_0x30, LD_HL_SP_r8, LD_SP_HL, LD_A_a16, EI, NOP, NOP, CP_d8, RST_0x38};
-
-static const void (*cb[0x100])() = {RLC_B, RLC_C, RLC_D, RLC_E, RLC_H, RLC_L, RLC_HL, RLC_A, RRC_B, RRC_C, RRC_D, RRC_E, RRC_H, RRC_L, RRC_HL, RRC_A,
-        RL_B, RL_C, RL_D, RL_E, RL_H, RL_L, RL_HL, RL_A, RR_B, RR_C, RR_D, RR_E, RR_H, RR_L, RR_HL, RR_A,
-        SLA_B, SLA_C, SLA_D, SLA_E, SLA_H, SLA_L, SLA_HL, SLA_A, SRA_B, SRA_C, SRA_D, SRA_E, SRA_H, SRA_L, SRA_HL, SRA_A,
-        SWAP_B, SWAP_C, SWAP_D, SWAP_E, SWAP_H, SWAP_L, SWAP_HL, SWAP_A, SRL_B, SRL_C, SRL_D, SRL_E, SRL_H, SRL_L, SRL_HL, SRL_A,
-        BIT_0_B, BIT_0_C, BIT_0_D, BIT_0_E, BIT_0_H, BIT_0_L, BIT_0_HL, BIT_0_A, BIT_1_B, BIT_1_C, BIT_1_D, BIT_1_E, BIT_1_H, BIT_1_L, BIT_1_HL, BIT_1_A,
-        BIT_2_B, BIT_2_C, BIT_2_D, BIT_2_E, BIT_2_H, BIT_2_L, BIT_2_HL, BIT_2_A, BIT_3_B, BIT_3_C, BIT_3_D, BIT_3_E, BIT_3_H, BIT_3_L, BIT_3_HL, BIT_3_A,
-        BIT_4_B, BIT_4_C, BIT_4_D, BIT_4_E, BIT_4_H, BIT_4_L, BIT_4_HL, BIT_4_A, BIT_5_B, BIT_5_C, BIT_5_D, BIT_5_E, BIT_5_H, BIT_5_L, BIT_5_HL, BIT_5_A,
-        BIT_6_B, BIT_6_C, BIT_6_D, BIT_6_E, BIT_6_H, BIT_6_L, BIT_6_HL, BIT_6_A, BIT_7_B, BIT_7_C, BIT_7_D, BIT_7_E, BIT_7_H, BIT_7_L, BIT_7_HL, BIT_7_A,
-        RES_0_B, RES_0_C, RES_0_D, RES_0_E, RES_0_H, RES_0_L, RES_0_HL, RES_0_A, RES_1_B, RES_1_C, RES_1_D, RES_1_E, RES_1_H, RES_1_L, RES_1_HL, RES_1_A,
-        RES_2_B, RES_2_C, RES_2_D, RES_2_E, RES_2_H, RES_2_L, RES_2_HL, RES_2_A, RES_3_B, RES_3_C, RES_3_D, RES_3_E, RES_3_H, RES_3_L, RES_3_HL, RES_3_A,
-        RES_4_B, RES_4_C, RES_4_D, RES_4_E, RES_4_H, RES_4_L, RES_4_HL, RES_4_A, RES_5_B, RES_5_C, RES_5_D, RES_5_E, RES_5_H, RES_5_L, RES_5_HL, RES_5_A,
-        RES_6_B, RES_6_C, RES_6_D, RES_6_E, RES_6_H, RES_6_L, RES_6_HL, RES_6_A, RES_7_B, RES_7_C, RES_7_D, RES_7_E, RES_7_H, RES_7_L, RES_7_HL, RES_7_A,
-        SET_0_B, SET_0_C, SET_0_D, SET_0_E, SET_0_H, SET_0_L, SET_0_HL, SET_0_A, SET_1_B, SET_1_C, SET_1_D, SET_1_E, SET_1_H, SET_1_L, SET_1_HL, SET_1_A,
-        SET_2_B, SET_2_C, SET_2_D, SET_2_E, SET_2_H, SET_2_L, SET_2_HL, SET_2_A, SET_3_B, SET_3_C, SET_3_D, SET_3_E, SET_3_H, SET_3_L, SET_3_HL, SET_3_A,
-        SET_4_B, SET_4_C, SET_4_D, SET_4_E, SET_4_H, SET_4_L, SET_4_HL, SET_4_A, SET_5_B, SET_5_C, SET_5_D, SET_5_E, SET_5_H, SET_5_L, SET_5_HL, SET_5_A,
-        SET_6_B, SET_6_C, SET_6_D, SET_6_E, SET_6_H, SET_6_L, SET_6_HL, SET_6_A, SET_7_B, SET_7_C, SET_7_D, SET_7_E, SET_7_H, SET_7_L, SET_7_HL, SET_7_A};
-
-static const unsigned char lengths[0x100] = {1, 3, 1, 1, 1, 1, 2, 1, 3, 1, 1, 1, 1, 1, 2, 1,
-                                            1, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
-                                            2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
-                                            2, 3, 1, 1, 1, 1, 2, 1, 2, 1, 1, 1, 1, 1, 2, 1,
-                                            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                                            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                                            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                                            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                                            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                                            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                                            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                                            1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-                                            1, 1, 3, 3, 3, 1, 2, 1, 1, 1, 3, -1, 3, 3, 2, 1,
-                                            1, 1, 3, -1, 3, 1, 2, 1, 1, 1, 3, -1, 3, -1, 2, 1,
-                                            2, 1, 1, -1, -1, 1, 2, 1, 2, 1, 3, -1, -1, -1, 2, 1,
-                                            2, 1, 1, 1, -1, 1, 2, 1, 2, 1, 3, 1, -1, -1, 2, 1};
-
-static unsigned char fetch() {
-    unsigned char value = read_mmu(cpu.PC);
-    cpu.PC += 1;
+#define LENGTH_1(OPCODE, NAME) [OPCODE] = 1,
+#define LENGTH_2(OPCODE, NAME) [OPCODE] = 2,
+#define LENGTH_3(OPCODE, NAME) [OPCODE] = 3,
+#define LENGTH_NONE(OPCODE) [OPCODE] = -1,
+
+static const unsigned char lengths[0x100] = {OPCODES(LENGTH_1, LENGTH_2, LENGTH_3, LENGTH_NONE, LENGTH_NONE)};
+
+#endif
+
+static unsigned char fetch(Gameboy *gb) {
+    unsigned char value = read_mmu(gb, gb->cpu.PC);
+    gb->cpu.PC += 1;
     return value;
 }
 
@@ -82,118 +50,459 @@ static unsigned char fetch() {
  *   Bit 3: Serial   Interrupt Request (INT 58h)  (1=Request)
  *   Bit 4: Joypad   Interrupt Request (INT 60h)  (1=Request)
  */
-static void check_interrupt() {
+static void check_interrupt(Gameboy *gb) {
 
-    unsigned char interrupt_enable = read_mmu(0xFFFF);
-    unsigned char interrupt_flag = read_mmu(0xFF0F);
+    // interrupts that are both enabled and requested
+    unsigned char pending = gb->cpu.pending;
+    if (pending == 0)
+        return;
 
     for (unsigned char i = 0; i < 5; i++) {
-        // check for interrupt enable and interrupt request being set
-        if (interrupt_enable >> i & 1 && interrupt_flag >> i & 1) {
+        if (pending >> i & 1) {
 
-            if (cpu.halt)
-                cpu.halt = false;
+            if (gb->cpu.halt)
+                gb->cpu.halt = false;
 
-            if (!cpu.ime)
+            if (!gb->cpu.ime)
                 return;
 
             // reset corresponding bit
-            write_mmu(0xFF0F, read_mmu(0xFF0F) & ~(1 << i));
+            write_mmu(gb, 0xFF0F, read_mmu(gb, 0xFF0F) & ~(1 << i));
 
             // disable IME
-            cpu.ime = false;
+            gb->cpu.ime = false;
 
             // push PC to stack
-            write_mmu(cpu.SP - 1, cpu.PC >> 8);
-            write_mmu(cpu.SP - 2, cpu.PC & 0xFF);
-            cpu.SP -= 2;
+            write_mmu(gb, gb->cpu.SP - 1, gb->cpu.PC >> 8);
+            write_mmu(gb, gb->cpu.SP - 2, gb->cpu.PC & 0xFF);
+            gb->cpu.SP -= 2;
 
             // call corresponding interrupt address
-            cpu.PC = 0x40 + i * 8;
-            cpu.halt = false;
+            gb->cpu.PC = 0x40 + i * 8;
+            gb->cpu.halt = false;
+            PROFILE_INTERRUPT(gb, i);
         }
     }
 }
 
-static unsigned char next_instruction() {
+#ifndef THREADED_DISPATCH
 
-    check_interrupt();
+static unsigned char execute(Gameboy *gb) {
 
-    if (cpu.halt)
-        return 12;
-
-    unsigned char opcode = fetch();
+    unsigned char opcode = fetch(gb);
 
     if (opcode == 0xCB) {
-        opcode = fetch();
-        cb[opcode]();
+        opcode = fetch(gb);
+        cb[opcode](gb);
         return 8;
     }
 
     if (lengths[opcode] == 1)
-        return opcodes[opcode]();
+        return opcodes[opcode](gb);
 
-    unsigned char v1 = fetch();
+    unsigned char v1 = fetch(gb);
 
     if (lengths[opcode] == 2)
-        return ((int (*)(unsigned char))opcodes[opcode])(v1);
+        return ((int (*)(Gameboy *, unsigned char))opcodes[opcode])(gb, v1);
 
-    unsigned char v2 = fetch();
+    unsigned char v2 = fetch(gb);
     unsigned short arg = (v2 << 8) + v1;
 
-    return ((int (*)(unsigned short))opcodes[opcode])(arg);
+    return ((int (*)(Gameboy *, unsigned short))opcodes[opcode])(gb, arg);
+}
+
+#ifndef BLOCK_CACHE
+
+static void next_instructions(Gameboy *gb) {
+    Scheduler *s = &gb->scheduler;
+    while (s->now < s->next) {
+        check_interrupt(gb);
+
+        if (gb->cpu.halt) {
+            // only an event can raise the interrupt that ends HALT
+            s->now = s->next;
+            return;
+        }
+
+        PROFILE_INSTRUCTION(gb);
+        unsigned char cycles = execute(gb);
+        PROFILE_CYCLES(gb, cycles);
+        s->now += cycles;
+    }
+}
+
+#else
+
+// the handlers with their prototypes, as decoded blocks call them
+#define HANDLER_NONE_OPERAND(OPCODE, NAME) [OPCODE] = {.none = NAME},
+#define HANDLER_d8(OPCODE, NAME) [OPCODE] = {.d8 = NAME},
+#define HANDLER_d16(OPCODE, NAME) [OPCODE] = {.d16 = NAME},
+#define HANDLER_UNUSED(OPCODE) [OPCODE] = {.none = NOP},
+
+static const Handler handlers[0x100] = {
+    OPCODES(HANDLER_NONE_OPERAND, HANDLER_d8, HANDLER_d16, HANDLER_UNUSED, HANDLER_UNUSED)};
+
+// jumps, calls, returns and HALT end a basic block
+static const bool ends_block[0x100] = {
+    [0x18] = true, [0x20] = true, [0x28] = true, [0x30] = true, [0x38] = true, [0x76] = true,
+    [0xC0] = true, [0xC2] = true, [0xC3] = true, [0xC4] = true, [0xC7] = true, [0xC8] = true, [0xC9] = true,
+    [0xCA] = true, [0xCC] = true, [0xCD] = true, [0xCF] = true, [0xD0] = true, [0xD2] = true, [0xD4] = true,
+    [0xD7] = true, [0xD8] = true, [0xD9] = true, [0xDA] = true, [0xDC] = true, [0xDF] = true, [0xE7] = true,
+    [0xE9] = true, [0xEF] = true, [0xF7] = true, [0xFF] = true,
+};
+
+/*
+ * End of the memory region a block starting at pc has to stay in, 0 if code at pc is not cached.
+ * Code in VRAM, OAM and IO registers always runs uncached.
+ */
+static unsigned int region_end(unsigned short pc) {
+    if (pc < 0x4000)
+        return 0x4000;
+    if (pc < 0x8000)
+        return 0x8000;
+    if (pc >= 0xA000 && pc < 0xE000)
+        return 0xE000;
+    if (pc >= 0xFF80 && pc < 0xFFFF)
+        return 0xFFFF;
+    return 0;
+}
+
+static bool block_valid(Gameboy *gb, Block *block) {
+    if (block->pc < 0x4000)
+        return true;
+    if (block->pc < 0x8000)
+        return block->bank == gb->mmu.mbc.rom_bank_number;
+    return block->generation == gb->cache.generation;
+}
+
+void invalidate_blocks(Gameboy *gb) {
+    gb->cache.generation++;
+    memset(gb->cache.code, 0, sizeof(gb->cache.code));
+    map_memory(gb, 0x80, 0xFF);
+}
+
+Block *decode_block(Gameboy *gb, Block *block, unsigned short pc, unsigned char bank) {
+    unsigned int end = region_end(pc);
+
+    block->pc = pc;
+    block->bank = bank;
+    block->count = 0;
+    block->generation = gb->cache.generation;
+#ifdef JIT
+    block->hits = 0;
+#endif
+#ifdef AOT
+    block->code = gb->aot != NULL ? aot_lookup(gb->aot, bank, pc) : NULL;
+#elif defined(JIT)
+    block->code = NULL;
+#endif
+
+    while (block->count < BLOCK_LENGTH) {
+        Decoded *instruction = &block->instructions[block->count];
+        unsigned char opcode = read_mmu(gb, pc);
+
+        if (opcode == 0xCB) {
+            instruction->length = 2;
+            instruction->operand = OPERAND_CB;
+        } else if (lengths[opcode] > 3) {
+            // unused opcode, 3 byte NOP
+            instruction->length = 3;
+            instruction->operand = OPERAND_NONE;
+        } else {
+            instruction->length = lengths[opcode];
+            instruction->operand = lengths[opcode] - 1;
+        }
+
+        if (pc + instruction->length > end)
+            break;
+
+        if (opcode == 0xCB) {
+            instruction->arg = read_mmu(gb, pc + 1);
+            instruction->handler.cb = cb[instruction->arg];
+        } else {
+            instruction->handler = handlers[opcode];
+            if (instruction->operand == OPERAND_d8)
+                instruction->arg = read_mmu(gb, pc + 1);
+            else if (instruction->operand == OPERAND_d16)
+                instruction->arg = (read_mmu(gb, pc + 2) << 8) + read_mmu(gb, pc + 1);
+        }
+
+        // remember which RAM bytes hold code, so that writing to them drops the block
+        if (pc >= 0x8000) {
+            for (unsigned short addr = pc; addr < pc + instruction->length; addr++) {
+                gb->cache.code[(addr - 0x8000) >> 3] |= 1 << (addr & 7);
+                gb->map.write[addr >> 8] = NULL;
+            }
+        }
+
+        instruction->opcode = opcode;
+        block->count++;
+        pc += instruction->length;
+
+        if (opcode != 0xCB && ends_block[opcode])
+            break;
+    }
+
+    return block->count > 0 ? block : NULL;
+}
+
+static Block *lookup_block(Gameboy *gb) {
+    unsigned short pc = gb->cpu.PC;
+
+    if (region_end(pc) == 0)
+        return NULL;
+
+    unsigned char bank = pc >= 0x4000 && pc < 0x8000 ? gb->mmu.mbc.rom_bank_number : 0;
+    Block *block = &gb->cache.blocks[(pc ^ bank << 4) % BLOCK_CACHE_SIZE];
+
+    if (block->count > 0 && block->pc == pc && block->bank == bank && block_valid(gb, block))
+        return block;
+
+    return decode_block(gb, block, pc, bank);
+}
+
+static unsigned char execute_decoded(Gameboy *gb, Decoded *instruction) {
+    switch (instruction->operand) {
+    case OPERAND_d8:
+        return instruction->handler.d8(gb, instruction->arg);
+    case OPERAND_d16:
+        return instruction->handler.d16(gb, instruction->arg);
+    case OPERAND_CB:
+        instruction->handler.cb(gb);
+        return 8;
+    default:
+        return instruction->handler.none(gb);
+    }
+}
+
+/*
+ * Runs a block until its end, the next scheduled event, or until it is invalidated by a bank switch or
+ * a write to its own code. Leaves the block as soon as an interrupt is pending, check_interrupt would be a
+ * no-op otherwise, so this steps exactly like next_instruction does.
+ */
+static void run_block(Gameboy *gb, Block *block) {
+    Decoded *instruction = block->instructions;
+    Decoded *last = block->instructions + block->count - 1;
+
+    while (true) {
+        PROFILE_INSTRUCTION(gb);
+        gb->cpu.PC += instruction->length;
+        unsigned char cycles = execute_decoded(gb, instruction);
+        PROFILE_CYCLES(gb, cycles);
+        gb->scheduler.now += cycles;
+
+        if (instruction == last || gb->scheduler.now >= gb->scheduler.next || !block_valid(gb, block) ||
+            gb->cpu.pending)
+            return;
+
+        instruction++;
+    }
 }
 
-static void next_instructions(int cycles) {
-    unsigned char cur_cycles;
-    while (cycles > 0) {
-        cur_cycles = next_instruction();
-        timer(cur_cycles);
-        cycles -= cur_cycles;
+#if defined(JIT) || defined(AOT)
+
+#ifdef JIT_CHECK
+/*
+ * Lockstep check: runs every compiled block a second time with the interpreter on a copy of the
+ * emulation state and aborts on the first difference.
+ */
+static void run_checked(Gameboy *gb, Block *block) {
+    Gameboy *shadow = gb->jit.shadow;
+    if (shadow == NULL)
+        shadow = gb->jit.shadow = calloc(1, sizeof(Gameboy));
+
+    // the shadow works on its own copy of the external RAM
+    unsigned char *ram = shadow->mmu.mbc.ram;
+    if (ram == NULL && gb->mmu.mbc.ram != NULL)
+        ram = malloc(gb->mmu.mbc.ram_size);
+    if (ram != NULL)
+        memcpy(ram, gb->mmu.mbc.ram, gb->mmu.mbc.ram_size);
+
+    shadow->cpu = gb->cpu;
+    shadow->mmu = gb->mmu;
+    shadow->mmu.mbc.ram = ram;
+    shadow->scheduler = gb->scheduler;
+    shadow->timer = gb->timer;
+    shadow->controls = gb->controls;
+    shadow->cgb = gb->cgb;
+    shadow->io = gb->io;
+    shadow->cache.generation = gb->cache.generation;
+    memcpy(shadow->cache.code, gb->cache.code, sizeof(gb->cache.code));
+    map_memory(shadow, 0, 0xFF);
+
+    block->code(gb);
+
+    // compiled blocks may jump back to their own start and run again, as long as next_instructions would
+    do
+        run_block(shadow, block);
+    while (shadow->scheduler.now < gb->scheduler.now && shadow->cpu.PC == block->pc &&
+           shadow->scheduler.now < shadow->scheduler.next && !(shadow->cpu.pending && shadow->cpu.ime) &&
+           block_valid(shadow, block));
+
+    bool ram_differs = ram != NULL && memcmp(ram, gb->mmu.mbc.ram, gb->mmu.mbc.ram_size) != 0;
+    shadow->mmu.mbc.ram = gb->mmu.mbc.ram;
+    bool mmu_differs = memcmp(&shadow->mmu, &gb->mmu, sizeof(Mmu)) != 0;
+    shadow->mmu.mbc.ram = ram;
+
+    if (shadow->scheduler.now != gb->scheduler.now || shadow->scheduler.next != gb->scheduler.next ||
+        memcmp(&shadow->cpu, &gb->cpu, sizeof(Cpu)) != 0 ||
+        memcmp(&shadow->timer, &gb->timer, sizeof(Timer)) != 0 || mmu_differs || ram_differs ||
+        shadow->cache.generation != gb->cache.generation) {
+        fprintf(stderr, "JIT mismatch in block %02X:%04X, PC %04X instead of %04X\n", block->bank, block->pc,
+                gb->cpu.PC, shadow->cpu.PC);
+        abort();
     }
 }
+#endif
+
+static void run_compiled(Gameboy *gb, Block *block) {
+#ifdef JIT_CHECK
+    run_checked(gb, block);
+#else
+    block->code(gb);
+#endif
+}
+
+#endif
+
+static void next_instructions(Gameboy *gb) {
+    Scheduler *s = &gb->scheduler;
+    while (s->now < s->next) {
+        check_interrupt(gb);
 
-Frame next_frame() {
-    while (lcd_display_enable() == false) {
-        set_mode(0);
-        write_mmu(0xFF44, 0);
-        for (unsigned char i = 0; i < 154; i++) {
-            next_instructions(456);
+        if (gb->cpu.halt) {
+            // only an event can raise the interrupt that ends HALT
+            s->now = s->next;
+            return;
         }
+
+        Block *block = lookup_block(gb);
+        if (block == NULL) {
+            PROFILE_INSTRUCTION(gb);
+            unsigned char cycles = execute(gb);
+            PROFILE_CYCLES(gb, cycles);
+            s->now += cycles;
+            continue;
+        }
+
+#ifdef JIT
+        if (block->code == NULL && ++block->hits >= (block->pc < 0x8000 ? JIT_THRESHOLD : JIT_RAM_THRESHOLD)) {
+            block->code = jit_compile(gb, block);
+            if (block->code == NULL)
+                block->hits = 0; // tried again once it is hot again
+        }
+#endif
+#if defined(JIT) || defined(AOT)
+        if (block->code != NULL) {
+            run_compiled(gb, block);
+            continue;
+        }
+#endif
+        run_block(gb, block);
     }
+}
+
+#endif
+
+#else
 
-    // Resolution - 160x144 (20x18 tiles)
-    // 144 vertical lines
-    for (unsigned char i = 0; i < 144; i++) {
-        set_ly(i);
-
-        // MODE 2
-        // 77-83 clks
-        set_mode(2);
-        next_instructions(80);
-
-        // MODE 3
-        // 169-175 clks
-        set_mode(3);
-        next_instructions(172);
-        set_params(i);
-
-        // MODE 0
-        // 201-207 clks
-        set_mode(0);
-        next_instructions(204);
+/*
+ * Threaded interpreter core, selected with -DTHREADED_DISPATCH=1.
+ *
+ * Every opcode has its own label that decodes the operands inline, calls its handler directly and then
+ * dispatches the next opcode with its own indirect jump, instead of sharing a single indirect call through
+ * the opcodes[] table. This gives the branch predictor one jump site per opcode to learn from.
+ */
+static void next_instructions(Gameboy *gb) {
+
+#define LABEL(OPCODE, NAME) [OPCODE] = &&op_##OPCODE,
+#define LABEL_NONE(OPCODE) [OPCODE] = &&op_##OPCODE,
+#define LABEL_CB(OPCODE, NAME) [OPCODE] = &&cb_##OPCODE,
+
+    static const void *const dispatch[0x100] = {OPCODES(LABEL, LABEL, LABEL, LABEL_NONE, LABEL_NONE)};
+    static const void *const dispatch_cb[0x100] = {CB_OPCODES(LABEL_CB)};
+
+#define DISPATCH() \
+        do { \
+            if (gb->scheduler.now >= gb->scheduler.next) \
+                return; \
+            check_interrupt(gb); \
+            if (gb->cpu.halt) \
+                goto halted; \
+            PROFILE_INSTRUCTION(gb); \
+            goto *dispatch[fetch(gb)]; \
+        } while (0)
+
+#define RETIRE(CYCLES) \
+        do { \
+            unsigned char cycles = CYCLES; \
+            PROFILE_CYCLES(gb, cycles); \
+            gb->scheduler.now += cycles; \
+            DISPATCH(); \
+        } while (0)
+
+#define EXECUTE(OPCODE, NAME) \
+    op_##OPCODE: \
+        RETIRE(NAME(gb));
+
+#define EXECUTE_d8(OPCODE, NAME) \
+    op_##OPCODE: \
+        RETIRE(NAME(gb, fetch(gb)));
+
+#define EXECUTE_d16(OPCODE, NAME) \
+    op_##OPCODE: { \
+        unsigned char low = fetch(gb); \
+        unsigned char high = fetch(gb); \
+        RETIRE(NAME(gb, (high << 8) + low)); \
     }
 
-    set_vblank();
-    draw();
+// unused opcodes are treated as 3 byte NOP, like the table driven core does
+#define EXECUTE_ILLEGAL(OPCODE) \
+    op_##OPCODE: \
+        fetch(gb); \
+        fetch(gb); \
+        RETIRE(NOP(gb));
+
+#define EXECUTE_PREFIX(OPCODE) \
+    op_##OPCODE: \
+        goto *dispatch_cb[fetch(gb)];
+
+#define EXECUTE_CB(OPCODE, NAME) \
+    cb_##OPCODE: \
+        NAME(gb); \
+        RETIRE(8);
+
+    DISPATCH();
+
+halted:
+    // only an event can raise the interrupt that ends HALT
+    gb->scheduler.now = gb->scheduler.next;
+    return;
 
-    for (unsigned char i = 144; i <= 154; i++) {
-        set_ly(i);
-        // MODE 1
-        // 4560 clks
-        set_mode(1);
-        next_instructions(456);
+    OPCODES(EXECUTE, EXECUTE_d8, EXECUTE_d16, EXECUTE_ILLEGAL, EXECUTE_PREFIX)
+    CB_OPCODES(EXECUTE_CB)
+}
+
+#endif
+
+/*
+ * Runs the CPU from event to event until the PPU has finished a frame, see line_event in display.c.
+ * The frame is drawn into the buffer set with set_frame_output.
+ */
+void next_frame(Gameboy *gb) {
+    gb->display.frame_done = false;
+
+    // the worker draws the previous frame in the meantime
+    if (gb->display.pipeline != NULL)
+        submit_frame(gb);
+
+    while (true) {
+        run_events(gb);
+        if (gb->display.frame_done)
+            break;
+        next_instructions(gb);
     }
 
-    return gameboy.framebuffer;
+    if (gb->display.pipeline != NULL)
+        finish_frame(gb);
 }
\ No newline at end of file
@@ -11,10 +11,14 @@
 extern "C" {
 #endif
 
+typedef struct Gameboy Gameboy;
+
+// how the H flag follows from the operands of the last operation
+enum { HALF_CLEAR, HALF_SET, HALF_ADD, HALF_SUB, HALF_ADD16 };
+
 typedef struct {
     // 8 bit registers
     unsigned char A;
-    unsigned char F;
     unsigned char B;
     unsigned char C;
     unsigned char D;
@@ -22,64 +26,104 @@ typedef struct {
     unsigned char H;
     unsigned char L;
 
+    /*
+     * Flags, evaluated lazily: there is no F register, the ALU only stores what it has at hand and
+     * F() assembles the flags when they are read.
+     *   Z is set if z_result is 0
+     *   H is computed from h_op, h_a, h_b and h_carry
+     */
+    unsigned char z_result;
+    bool n_flag;
+    bool c_flag;
+    unsigned char h_op;
+    unsigned char h_carry;
+    unsigned short h_a;
+    unsigned short h_b;
+
     unsigned short SP;
     unsigned short PC;
 
     bool ime;
     bool halt;
+    unsigned char pending; // IE & IF, kept up to date by the writes to FF0F and FFFF
 } Cpu;
 
-extern Cpu cpu;
+void next_frame(Gameboy *gb);
 
-Frame next_frame();
+inline unsigned short BC(Cpu *cpu) { return (cpu->B << 8) + cpu->C; }
+inline unsigned short DE(Cpu *cpu) { return (cpu->D << 8) + cpu->E; }
+inline unsigned short HL(Cpu *cpu) { return (cpu->H << 8) + cpu->L; }
+inline unsigned short SP(Cpu *cpu) { return cpu->SP; }
 
-inline unsigned short AF() { return (cpu.A << 8) + cpu.F; }
-inline unsigned short BC() { return (cpu.B << 8) + cpu.C; }
-inline unsigned short DE() { return (cpu.D << 8) + cpu.E; }
-inline unsigned short HL() { return (cpu.H << 8) + cpu.L; }
-inline unsigned short SP() { return cpu.SP; }
-
-inline void set_AF(unsigned short value) {
-    cpu.A = value >> 8 & 0xFF;
-    cpu.F = value & 0xF0;
+inline void set_BC(Cpu *cpu, unsigned short value) {
+    cpu->B = value >> 8 & 0xFF;
+    cpu->C = value & 0xFF;
 }
 
-inline void set_BC(unsigned short value) {
-    cpu.B = value >> 8 & 0xFF;
-    cpu.C = value & 0xFF;
+inline void set_DE(Cpu *cpu, unsigned short value) {
+    cpu->D = value >> 8 & 0xFF;
+    cpu->E = value & 0xFF;
 }
 
-inline void set_DE(unsigned short value) {
-    cpu.D = value >> 8 & 0xFF;
-    cpu.E = value & 0xFF;
+inline void set_HL(Cpu *cpu, unsigned short value) {
+    cpu->H = value >> 8 & 0xFF;
+    cpu->L = value & 0xFF;
 }
 
-inline void set_HL(unsigned short value) {
-    cpu.H = value >> 8 & 0xFF;
-    cpu.L = value & 0xFF;
+inline void set_SP(Cpu *cpu, unsigned short value) { cpu->SP = value; }
+
+inline bool flag_Z(Cpu *cpu) { return cpu->z_result == 0; }
+inline bool flag_N(Cpu *cpu) { return cpu->n_flag; }
+inline bool flag_C(Cpu *cpu) { return cpu->c_flag; }
+
+inline bool flag_H(Cpu *cpu) {
+    switch (cpu->h_op) {
+    case HALF_SET:
+        return true;
+    case HALF_ADD:
+        return (cpu->h_a & 0xF) + (cpu->h_b & 0xF) + cpu->h_carry > 0xF;
+    case HALF_SUB:
+        return (cpu->h_a & 0xF) < (cpu->h_b & 0xF) + cpu->h_carry;
+    case HALF_ADD16:
+        return (cpu->h_a & 0xFFF) + (cpu->h_b & 0xFFF) > 0xFFF;
+    default:
+        return false;
+    }
 }
 
-inline void set_SP(unsigned short value) { cpu.SP = value; }
+inline void set_flag_Z(Cpu *cpu, bool set) { cpu->z_result = !set; }
+inline void set_flag_N(Cpu *cpu, bool set) { cpu->n_flag = set; }
+inline void set_flag_H(Cpu *cpu, bool set) { cpu->h_op = set ? HALF_SET : HALF_CLEAR; }
+inline void set_flag_C(Cpu *cpu, bool set) { cpu->c_flag = set; }
 
-inline bool get_bit(unsigned char i) { return cpu.F >> i & 1; }
+// Z - Set if result is zero.
+inline void set_result(Cpu *cpu, unsigned char result) { cpu->z_result = result; }
 
-inline void set_bit(unsigned char i, bool set) {
-    if (set) {
-        cpu.F |= 1 << i;
-    } else {
-        cpu.F &= ~(1 << i);
-    }
+// H from the carry out of bit 3 (bit 11 for HALF_ADD16) of a + b + carry, or the borrow into bit 4 of a - b - carry
+inline void set_half_carry(Cpu *cpu, unsigned char op, unsigned short a, unsigned short b, bool carry) {
+    cpu->h_op = op;
+    cpu->h_a = a;
+    cpu->h_b = b;
+    cpu->h_carry = carry;
 }
 
-inline bool flag_Z() { return get_bit(7); }
-inline bool flag_N() { return get_bit(6); }
-inline bool flag_H() { return get_bit(5); }
-inline bool flag_C() { return get_bit(4); }
+inline unsigned char F(Cpu *cpu) {
+    return flag_Z(cpu) << 7 | flag_N(cpu) << 6 | flag_H(cpu) << 5 | flag_C(cpu) << 4;
+}
+
+inline void set_F(Cpu *cpu, unsigned char value) {
+    set_flag_Z(cpu, value >> 7 & 1);
+    set_flag_N(cpu, value >> 6 & 1);
+    set_flag_H(cpu, value >> 5 & 1);
+    set_flag_C(cpu, value >> 4 & 1);
+}
 
-inline void set_flag_Z(bool set) { set_bit(7, set); }
-inline void set_flag_N(bool set) { set_bit(6, set); }
-inline void set_flag_H(bool set) { set_bit(5, set); }
-inline void set_flag_C(bool set) { set_bit(4, set); }
+inline unsigned short AF(Cpu *cpu) { return (cpu->A << 8) + F(cpu); }
+
+inline void set_AF(Cpu *cpu, unsigned short value) {
+    cpu->A = value >> 8 & 0xFF;
+    set_F(cpu, value & 0xF0);
+}
 
 #ifdef __cplusplus
 }
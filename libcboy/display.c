@@ -1,181 +1,275 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <string.h>
+
 #include "cpu.h"
 #include "gameboy.h"
 
 #define WIDTH 160
 #define HEIGHT 144
 
-static unsigned short background[256][256];
-static unsigned short window[256][256];
+void set_params(Gameboy *gb, unsigned char i) {
+    gb->display.scy[i] = read_mmu(gb, 0xFF42);
+    gb->display.scx[i] = read_mmu(gb, 0xFF43);
+    gb->display.wy[i] = read_mmu(gb, 0xFF4A);
+    gb->display.wx[i] = read_mmu(gb, 0xFF4B);
+}
+
+// the four shades of grey of the DMG
+static const unsigned short greys[4] = {0xffff, 0x4210, 0x2108, 0x0};
+
+// color 0-3 of palette 0-7, stored as 8 little endian RGB555 palettes of 4 colors
+static unsigned short cgb_color(const unsigned char *palettes, unsigned char index) {
+    return palettes[index * 2] | palettes[index * 2 + 1] << 8;
+}
+
+void invalidate_tiles(Gameboy *gb, unsigned short addr, unsigned short length) {
+    bool bank = gb->cgb && gb->mmu.ram[0xFF4F - 0x8000] & 1;
+
+    for (unsigned short tile = (addr - 0x8000) >> 4; tile <= (addr + length - 1 - 0x8000) >> 4; tile++)
+        gb->display.tiles.valid[bank][tile] = false;
+}
+
+static void decode_tile(Gameboy *gb, bool bank, unsigned short tile) {
+    const unsigned char *data = (bank ? gb->mmu.vram_bank : gb->mmu.ram) + tile * 16;
+
+    gb->display.kernels->decode_tile(data, gb->display.tiles.pixels[bank][tile]);
+    gb->display.tiles.valid[bank][tile] = true;
+}
+
+// color indices of one row of the tile at tile_addr, decoded again only when the tile data has changed
+static const unsigned char *tile_row(Gameboy *gb, bool bank, unsigned short tile_addr, unsigned char row, bool x_flip) {
+    unsigned short tile = (tile_addr - 0x8000) >> 4;
 
-static unsigned char scy[HEIGHT + 1] = {[0 ... HEIGHT] = 0};
-static unsigned char scx[HEIGHT + 1] = {[0 ... HEIGHT] = 0};
-static unsigned char wy[HEIGHT + 1] = {[0 ... HEIGHT] = 0};
-static unsigned char wx[HEIGHT + 1] = {[0 ... HEIGHT] = 0};
+    if (!gb->display.tiles.valid[bank][tile])
+        decode_tile(gb, bank, tile);
 
-void set_params(unsigned char i) {
-    scy[i] = read_mmu(0xFF42);
-    scx[i] = read_mmu(0xFF43);
-    wy[i] = read_mmu(0xFF4A);
-    wx[i] = read_mmu(0xFF4B);
+    return gb->display.tiles.pixels[bank][tile][x_flip][row];
 }
 
-static void draw_greyscale(unsigned char x, unsigned char y, unsigned char color) {
-    switch (color) {
-        case 0:
-            gameboy.framebuffer.buffer[x][y] = 0xffff;
+void set_frame_output(Gameboy *gb, void *pixels, unsigned int stride, PixelFormat format) {
+    gb->display.output = (FrameOutput){pixels, stride, format};
+    update_colors(gb, NULL);
+}
+
+void set_headless(Gameboy *gb, bool headless) { gb->display.headless = headless; }
+
+// stores color i of the table in the output format, from 5 bits each of red, green and blue or the index
+static void set_color(Colors *colors, PixelFormat format, unsigned char i, unsigned short color, unsigned char index) {
+    unsigned char r = color & 0x1F, g = (color >> 5) & 0x1F, b = (color >> 10) & 0x1F;
+    unsigned char rgba[4] = {r << 3 | r >> 2, g << 3 | g >> 2, b << 3 | b >> 2, 0xFF};
+
+    switch (format) {
+        case PIXEL_RGB565:
+            colors->rgb565[i] = r << 11 | (g << 1 | g >> 4) << 5 | b;
             break;
-        case 1:
-            gameboy.framebuffer.buffer[x][y] = 0x4210;
+        case PIXEL_XRGB8888:
+            colors->rgb32[i] = 0xFFu << 24 | rgba[0] << 16 | rgba[1] << 8 | rgba[2];
             break;
-        case 2:
-            gameboy.framebuffer.buffer[x][y] = 0x2108;
+        case PIXEL_RGBA8888:
+            memcpy(&colors->rgb32[i], rgba, 4);
             break;
-        case 3:
-            gameboy.framebuffer.buffer[x][y] = 0x0;
+        case PIXEL_INDEX8:
+            colors->index8[i] = index;
             break;
     }
 }
 
-static void draw_color(unsigned char x, unsigned char y, unsigned short color) {
-    gameboy.framebuffer.buffer[x][y] = color;
+// converts count colors of the table from first on, the DMG only uses 0-3 of BGP, 32-35 of OBP0 and 36-39 of OBP1
+static void set_colors(Gameboy *gb, unsigned char first, unsigned char count) {
+    Colors *colors = &gb->display.colors;
+    PixelFormat format = gb->display.output.format;
+
+    for (unsigned char i = first; i < first + count; i++) {
+        if (gb->cgb) {
+            const unsigned char *palettes = i < 32 ? gb->mmu.bg_palette : gb->mmu.sprite_palette;
+            set_color(colors, format, i, cgb_color(palettes, i % 32), i);
+        } else if (i < 4 || (i >= 32 && i < 40)) {
+            unsigned char palette = gb->mmu.ram[(i < 4 ? 0xFF47 : i < 36 ? 0xFF48 : 0xFF49) - 0x8000];
+            unsigned char shade = (palette >> (i % 4 * 2)) & 3;
+            set_color(colors, format, i, greys[shade], shade);
+        }
+    }
+}
+
+void update_colors(Gameboy *gb, const unsigned char *palette) {
+    Mmu *mmu = &gb->mmu;
+
+    if (palette == NULL)
+        set_colors(gb, 0, 64);
+    else if (palette >= mmu->bg_palette && palette < mmu->bg_palette + 0x40)
+        set_colors(gb, (palette - mmu->bg_palette) / 2, 1);
+    else if (palette >= mmu->sprite_palette && palette < mmu->sprite_palette + 0x40)
+        set_colors(gb, 32 + (palette - mmu->sprite_palette) / 2, 1);
+    else if (palette == &mmu->ram[0xFF47 - 0x8000])
+        set_colors(gb, 0, 4);
+    else if (palette == &mmu->ram[0xFF48 - 0x8000])
+        set_colors(gb, 32, 4);
+    else if (palette == &mmu->ram[0xFF49 - 0x8000])
+        set_colors(gb, 36, 4);
+}
+
+// address of the tile at x, y of the background or window map, the map is always in VRAM bank 0
+static unsigned short get_tile(Gameboy *gb, unsigned char x, unsigned char y, bool window) {
+    bool map_display_select = window ? window_tile_map_display_select(gb) : bg_tile_map_display_select(gb);
+    unsigned char tile = gb->mmu.ram[(map_display_select ? 0x9C00 : 0x9800) + y * 32 + x - 0x8000];
+
+    return (bg_window_tile_data_select(gb) ? 0x8000 : 0x9000) +
+           (bg_window_tile_data_select(gb) ? tile : (tile ^ 0x80) - 0x80) * 16;
+}
+
+/*
+ * Composes the map pixels from screen column x to the right edge of the line, starting at pixel map_x, map_y
+ * of the background or window map. Only the tiles that are visible on the line are fetched.
+ */
+static void render_map(Gameboy *gb, unsigned char *line, unsigned char x, unsigned char map_x, unsigned char map_y,
+                       bool window) {
+    bool map_display_select = window ? window_tile_map_display_select(gb) : bg_tile_map_display_select(gb);
+
+    while (x < WIDTH) {
+        unsigned short tile_addr = get_tile(gb, map_x / 8, map_y / 8, window);
+        unsigned char attr = gb->mmu.vram_bank[(map_display_select ? 0x9C00 : 0x9800) + map_y / 8 * 32 + map_x / 8 - 0x8000];
+        unsigned char palette = gb->cgb ? (attr & 7) << 2 : 0;
+
+        const unsigned char *pixels = tile_row(gb, attr >> 3 & 1, tile_addr, map_y % 8, false);
+
+        for (unsigned char bit = map_x % 8; bit < 8 && x < WIDTH; bit++, x++, map_x++)
+            line[x] = palette | pixels[bit];
+    }
 }
 
-static void draw_sprite(unsigned char offset_x, unsigned char offset_y, unsigned short tile_offset, unsigned char attr) {
+// composes the row of an 8x8 sprite tile that is on the line
+static void render_sprite(Gameboy *gb, unsigned char *line, unsigned char offset_x, unsigned char row,
+                          unsigned short tile_offset, unsigned char attr) {
     unsigned char palette_number = attr & 3;
-    bool vram_bank = attr >> 3 & 1;
+    bool vram_bank = gb->cgb && attr >> 3 & 1;
     bool obp1 = attr >> 4 & 1;
     bool x_flip = attr >> 5 & 1;
     bool y_flip = attr >> 6 & 1;
 
-    unsigned long color_palette;
-    unsigned char palette;
+    unsigned char palette = 32 | (gb->cgb ? palette_number : obp1) << 2;
 
-    if (gameboy.cgb)
-        color_palette = *(unsigned long *)(gameboy.mmu.sprite_palette + palette_number * sizeof(long));
-    else
-        palette = read_mmu(obp1 ? 0xFF49 : 0xFF48);
+    const unsigned char *pixels = tile_row(gb, vram_bank, tile_offset, y_flip ? 7 - row : row, x_flip);
 
-    for (unsigned char y = 0; y < 8; y++) {
-        for (unsigned char x = 0; x < 8; x++) {
+    for (unsigned char x = 0; x < 8; x++) {
+        if (offset_x + x < 8 || offset_x + x >= WIDTH + 8)
+            continue;
 
-            if (offset_x + x < 8 || offset_y + y < 16 || offset_x + x >= WIDTH + 8 || offset_y + y >= HEIGHT + 16)
-                continue;
-
-            unsigned char color;
-            unsigned short offset = (y_flip ? 7 - y : y) * 2 + tile_offset - 0x8000;
-            if (!vram_bank)
-                color = gameboy.mmu.ram[offset];
-            else
-                color = gameboy.mmu.vram_bank[offset];
+        if (pixels[x] != 0)
+            line[offset_x + x - 8] = palette | pixels[x];
+    }
+}
 
-            color = ((color >> (x_flip ? x : (7 - x))) & 1) | (((gameboy.mmu.ram[offset + 1] >> (x_flip ? x : (7 - x))) & 1) << 1);
+static void render_sprites(Gameboy *gb, unsigned char *line, unsigned char ly) {
+    for (unsigned char i = 0; i < 0xA0; i += 4) {
+        unsigned char y = read_mmu(gb, 0xFE00 + i);
+        unsigned char x = read_mmu(gb, 0xFE00 + i + 1);
+        unsigned char tile = read_mmu(gb, 0xFE00 + i + 2);
+        unsigned char attr = read_mmu(gb, 0xFE00 + i + 3);
 
-            if (color == 0)
-                continue;
+        // sprites are placed 16 lines above the screen
+        unsigned char row = ly + 16 - y;
 
-            if (gameboy.cgb)
-                draw_color(offset_y + y - 16, offset_x + x - 8, (color_palette >> (16 * color)) & 0xffff);
-            else
-                draw_greyscale(offset_y + y - 16, offset_x + x - 8, (palette >> (color * 2)) & 3);
+        if (obj_sprite_size(gb) == 0) {
+            // 8x8 sprite
+            if (row < 8)
+                render_sprite(gb, line, x, row, 0x8000 + tile * 16, attr);
+        } else {
+            // 8x16 sprite
+            if (row < 8)
+                render_sprite(gb, line, x, row, 0x8000 + (tile & 0xFE) * 16, attr);
+            else if (row < 16)
+                render_sprite(gb, line, x, row - 8, 0x8000 + (tile | 1) * 16, attr);
         }
     }
 }
 
-static void draw_tile(unsigned char offset_x, unsigned char offset_y, bool window, unsigned short buffer[256][256]) {
-    unsigned short tile_addr = get_tile(offset_x, offset_y, window);
-    unsigned char first, second, attr, color, palette;
-    unsigned long color_palette;
+/*
+ * Draws line ly at the end of its mode 3, with the scroll and window positions latched for it.
+ * The window has its own line counter, it continues where it left off when it was hidden on some lines.
+ */
+void render_line(Gameboy *gb, unsigned char ly) {
+    Display *d = &gb->display;
+    unsigned char line[WIDTH];
+    bool window = window_display_enable(gb) && ly >= d->wy[ly] && d->wx[ly] < WIDTH + 7;
 
-    bool map_display_select = window ? window_tile_map_display_select() : bg_tile_map_display_select();
-    attr = gameboy.mmu.vram_bank[(map_display_select ? 0x9C00 : 0x9800) + offset_y * 32 + offset_x - 0x8000];
-    for (unsigned char y = 0; y < 8; y++) {
+    if (d->headless || d->output.pixels == NULL) {
+        // nothing to draw into, the window still counts its lines
+        d->window_line += window;
+        return;
+    }
 
-        unsigned short offset = y * 2 + tile_addr - 0x8000;
-        if (attr >> 3 & 1) {
-            first = gameboy.mmu.vram_bank[offset];
-            second = gameboy.mmu.vram_bank[offset + 1];
-        } else {
-            first = gameboy.mmu.ram[offset];
-            second = gameboy.mmu.ram[offset + 1];
-        }
+    render_map(gb, line, 0, d->scx[ly], ly + d->scy[ly], false);
 
-        if (gameboy.cgb)
-            color_palette = *(unsigned long *)(gameboy.mmu.bg_palette + (attr & 7) * sizeof(long));
+    if (window) {
+        if (d->wx[ly] >= 7)
+            render_map(gb, line, d->wx[ly] - 7, 0, d->window_line, true);
         else
-            palette = read_mmu(0xFF47);
+            render_map(gb, line, 0, 7 - d->wx[ly], d->window_line, true);
+        d->window_line++;
+    }
 
-        for (unsigned char x = 0; x < 8; x++) {
-            color = ((first >> (7 - x)) & 1) | ((second >> (7 - x)) & 1) << 1;
+    render_sprites(gb, line, ly);
 
-            if (gameboy.cgb)
-                buffer[offset_x * 8 + x][offset_y * 8 + y] = (color_palette >> (16 * color)) & 0xffff;
-            else
-                buffer[offset_x * 8 + x][offset_y * 8 + y] = (unsigned short)(palette >> (color * 2)) & 3;
-        }
-    }
+    unsigned char *out = d->output.pixels + ly * d->output.stride;
+    if (d->output.format == PIXEL_INDEX8)
+        d->kernels->map_line8(line, d->colors.index8, out);
+    else if (d->output.format == PIXEL_RGB565)
+        d->kernels->map_line16(line, d->colors.rgb565, (unsigned short *)out);
+    else
+        d->kernels->map_line32(line, d->colors.rgb32, (unsigned int *)out);
 }
 
-static void render_bg() {
-    for (unsigned char y = 0; y < 32; y++) {
-        for (unsigned char x = 0; x < 32; x++) {
-            draw_tile(x, y, false, background);
-        }
-    }
+/*
+ * A frame is 155 lines of 456 clks: 144 visible lines of mode 2 (80 clks), mode 3 (172 clks) and
+ * mode 0 (204 clks), followed by V-Blank lines in mode 1. Every line schedules the next one.
+ */
+void line_event(Gameboy *gb, unsigned long long when) {
+    Display *d = &gb->display;
 
-    for (unsigned char y = 0; y < HEIGHT; y++) {
-        for (unsigned char x = 0; x < WIDTH; x++) {
-            if (gameboy.cgb)
-                draw_color(y, x, background[(x + scx[y]) % 256][(y + scy[y]) % 256]);
-            else
-                draw_greyscale(y, x, background[(x + scx[y]) % 256][(y + scy[y]) % 256]);
-        }
+    if (d->line == 155) {
+        d->line = 0;
+        d->window_line = 0;
+        d->frame_done = true;
+        if (d->pipeline != NULL)
+            record_write(gb, &d->window_line);
     }
-}
 
-static void render_window() {
-    if (!window_display_enable())
+    if (d->line == 0 && !lcd_display_enable(gb)) {
+        // LCD off, look again after a frame
+        set_mode(gb, 0);
+        write_mmu(gb, 0xFF44, 0);
+        schedule(gb, EVENT_LINE, when + 154 * 456);
         return;
-
-    for (unsigned char y = 0; y < 32; y++) {
-        for (unsigned char x = 0; x < 32; x++) {
-            draw_tile(x, y, true, window);
-        }
     }
 
-    for (unsigned char y = 0; y < HEIGHT; y++) {
-        for (unsigned char x = 0; x < WIDTH; x++) {
-            if (x + wx[y] >= 7 && x + wx[y] < WIDTH + 7 && y + wy[y] >= 0 && y + wy[y] < HEIGHT) {
-                if (gameboy.cgb)
-                    draw_color(y + wy[y], x + wx[y] - 7, window[x][y]);
-                else
-                    draw_greyscale(y + wy[y], x + wx[y] - 7, window[x][y]);
-            }
-        }
+    if (d->line < 144) {
+        set_ly(gb, d->line);
+        set_mode(gb, 2);
+        schedule(gb, EVENT_TRANSFER, when + 80);
+    } else {
+        if (d->line == 144)
+            set_vblank(gb);
+        set_ly(gb, d->line);
+        set_mode(gb, 1);
     }
-}
 
-static void render_sprites() {
-    for (unsigned char i = 0; i < 0xA0; i += 4) {
-        unsigned char y = read_mmu(0xFE00 + i);
-        unsigned char x = read_mmu(0xFE00 + i + 1);
-        unsigned char tile = read_mmu(0xFE00 + i + 2);
-        unsigned char attr = read_mmu(0xFE00 + i + 3);
+    schedule(gb, EVENT_LINE, when + 456);
+    d->line++;
+}
 
-        if (obj_sprite_size() == 0) {
-            // 8x8 sprite
-            draw_sprite(x, y, 0x8000 + tile * 16, attr);
-        } else {
-            // 8x16 sprite
-            draw_sprite(x, y, 0x8000 + (tile & 0xFE) * 16, attr);
-            draw_sprite(x, y + 8, 0x8000 + (tile | 1) * 16, attr);
-        }
-    }
+void transfer_event(Gameboy *gb, unsigned long long when) {
+    set_mode(gb, 3);
+    schedule(gb, EVENT_HBLANK, when + 172);
 }
 
-void draw() {
-    render_bg();
-    render_window();
-    render_sprites();
+void hblank_event(Gameboy *gb, unsigned long long when) {
+    (void)when;
+    set_params(gb, gb->display.line - 1);
+    if (gb->display.pipeline != NULL)
+        record_line(gb, gb->display.line - 1);
+    else
+        render_line(gb, gb->display.line - 1);
+    set_mode(gb, 0);
+    hdma_hblank(gb);
 }
\ No newline at end of file
@@ -3,17 +3,99 @@
 #ifndef LIBCBOY_DISPLAY_H
 #define LIBCBOY_DISPLAY_H
 
+#include <stdbool.h>
+
+#include "pipeline.h"
+#include "pixels.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct Gameboy Gameboy;
+
+/*
+ * Pixel formats of the frame output:
+ * PIXEL_RGB565   - 16 bit values, red in the upper 5 bits
+ * PIXEL_XRGB8888 - 32 bit values 0xFFRRGGBB
+ * PIXEL_RGBA8888 - the bytes red, green, blue and 0xFF
+ * PIXEL_INDEX8   - DMG: shade 0-3 from white to black
+ *                  CGB: color 0-3 of background palette 0-7 at 0-31, of sprite palette 0-7 at 32-63
+ */
+typedef enum { PIXEL_RGB565, PIXEL_XRGB8888, PIXEL_RGBA8888, PIXEL_INDEX8 } PixelFormat;
+
+typedef struct {
+    unsigned char *pixels; // 144 lines of 160 pixels, nothing is drawn while NULL
+    unsigned int stride;   // bytes from the start of one line to the next
+    PixelFormat format;
+} FrameOutput;
+
+/*
+ * Lines are composed of indices into a table of 64 colors, the background and window use the first 32
+ * and sprites the last 32. Each group holds 8 palettes of 4 colors, like the CGB palette memory.
+ * The table is kept in the output format and converted again only when a palette changes.
+ */
+typedef union {
+    unsigned char index8[64];
+    unsigned short rgb565[64];
+    unsigned int rgb32[64];
+} Colors;
+
+/*
+ * The 384 tiles of both VRAM banks decoded to one color index per pixel, with a horizontally flipped copy
+ * for sprites. Writes to the tile data clear valid, the tile is decoded again the next time it is drawn.
+ */
+typedef struct {
+    bool valid[2][384];
+    unsigned char pixels[2][384][2][8][8]; // bank, tile, x flip, row, column
+} TileCache;
+
 typedef struct {
-    unsigned short buffer[144][160];
-} Frame;
+    unsigned char line; // LY of the next EVENT_LINE
+    bool frame_done;    // set when the last line of a frame has ended
+    unsigned char window_line; // line of the window map drawn next
+    bool headless;             // draw nothing, see set_headless
+
+    // scroll and window positions latched for every line
+    unsigned char scy[145];
+    unsigned char scx[145];
+    unsigned char wy[145];
+    unsigned char wx[145];
+
+    FrameOutput output;
+    Colors colors;
+    Pipeline *pipeline;          // draws on a worker thread while set, see start_pipeline
+    const PixelKernels *kernels; // picked for the host CPU by load_rom
+    TileCache tiles;
+} Display;
+
+void set_params(Gameboy *gb, unsigned char i);
+
+/*
+ * Every line is written straight into pixels when it is drawn, the buffer has to stay valid until it is
+ * replaced. Set it after load_rom.
+ */
+void set_frame_output(Gameboy *gb, void *pixels, unsigned int stride, PixelFormat format);
+
+/*
+ * Skips drawing from the next line on, or resumes it. The PPU keeps its timing, STAT, LY and the
+ * interrupts, so this can be switched at any time, e.g. to draw only some of the frames.
+ */
+void set_headless(Gameboy *gb, bool headless);
+
+// converts the colors that depend on the palette register or CGB palette memory byte again, all when NULL
+void update_colors(Gameboy *gb, const unsigned char *palette);
+
+// drops the decoded tiles in length bytes of tile data from addr on, in the VRAM bank selected by VBK
+void invalidate_tiles(Gameboy *gb, unsigned short addr, unsigned short length);
 
-void draw();
+// draws line ly with the scroll and window positions latched for it
+void render_line(Gameboy *gb, unsigned char ly);
 
-void set_params(unsigned char i);
+// PPU timing, driven by the scheduler
+void line_event(Gameboy *gb, unsigned long long when);
+void transfer_event(Gameboy *gb, unsigned long long when);
+void hblank_event(Gameboy *gb, unsigned long long when);
 
 void toggle_fullscreen();
 
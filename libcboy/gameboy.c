@@ -5,94 +5,102 @@
 #include <string.h>
 
 #include "gameboy.h"
-
-Gameboy gameboy = {.controls = 0xFF,
-                   .mmu.mbc.rom_bank_number = 1,
-                   .mmu.mbc.ram_bank_number = 0,
-                   .mmu.mbc.rom_ram_select = 0};
-
-void init() {
-    memset(gameboy.mmu.ram, 0, 0x8000);
-    memset(gameboy.mmu.bg_palette, 0, 0x1000);
-    memset(gameboy.mmu.sprite_palette, 0, 0x1000);
-    memset(gameboy.mmu.vram_bank, 0, 0x2000);
-
-    cpu.PC = 0x100;
-    cpu.SP = 0xfffe;
-    set_AF(0x11b0);
-    set_BC(0x13);
-    set_DE(0xd8);
-    set_HL(0x14d);
-
-    write_mmu(0xFF05, 0x0);
-    write_mmu(0xFF06, 0x0);
-    write_mmu(0xFF07, 0x0);
-    write_mmu(0xFF10, 0x80);
-    write_mmu(0xFF11, 0xbf);
-    write_mmu(0xFF12, 0xf3);
-    write_mmu(0xFF14, 0xbf);
-    write_mmu(0xFF16, 0x3f);
-    write_mmu(0xFF17, 0x0);
-    write_mmu(0xFF19, 0xbf);
-    write_mmu(0xFF1a, 0x7f);
-    write_mmu(0xFF1b, 0xff);
-    write_mmu(0xFF1c, 0x9f);
-    write_mmu(0xFF1e, 0xbf);
-    write_mmu(0xFF20, 0xff);
-    write_mmu(0xFF21, 0x0);
-    write_mmu(0xFF22, 0x0);
-    write_mmu(0xFF23, 0xbf);
-    write_mmu(0xFF24, 0x77);
-    write_mmu(0xFF25, 0xf3);
-    write_mmu(0xFF26, 0xf1);
-    write_mmu(0xFF40, 0x91);
-    write_mmu(0xFF42, 0x0);
-    write_mmu(0xFF43, 0x0);
-    write_mmu(0xFF45, 0x0);
-    write_mmu(0xFF47, 0xfc);
-    write_mmu(0xFF48, 0xff);
-    write_mmu(0xFF49, 0xff);
-    write_mmu(0xFF4a, 0x0);
-    write_mmu(0xFF4b, 0x0);
-    write_mmu(0xFFFF, 0x0);
+#include "rom.h"
+
+static void init(Gameboy *gb) {
+    gb->controls = 0xFF;
+    gb->mmu.mbc.rom_bank_number = 1;
+    gb->display.kernels = best_pixel_kernels();
+    map_memory(gb, 0, 0xFF);
+    init_io(gb);
+
+    gb->cpu.PC = 0x100;
+    gb->cpu.SP = 0xfffe;
+    gb->cpu.ime = true;
+    set_AF(&gb->cpu, 0x11b0);
+    set_BC(&gb->cpu, 0x13);
+    set_DE(&gb->cpu, 0xd8);
+    set_HL(&gb->cpu, 0x14d);
+
+    write_mmu(gb, 0xFF05, 0x0);
+    write_mmu(gb, 0xFF06, 0x0);
+    write_mmu(gb, 0xFF07, 0x0);
+    write_mmu(gb, 0xFF10, 0x80);
+    write_mmu(gb, 0xFF11, 0xbf);
+    write_mmu(gb, 0xFF12, 0xf3);
+    write_mmu(gb, 0xFF14, 0xbf);
+    write_mmu(gb, 0xFF16, 0x3f);
+    write_mmu(gb, 0xFF17, 0x0);
+    write_mmu(gb, 0xFF19, 0xbf);
+    write_mmu(gb, 0xFF1a, 0x7f);
+    write_mmu(gb, 0xFF1b, 0xff);
+    write_mmu(gb, 0xFF1c, 0x9f);
+    write_mmu(gb, 0xFF1e, 0xbf);
+    write_mmu(gb, 0xFF20, 0xff);
+    write_mmu(gb, 0xFF21, 0x0);
+    write_mmu(gb, 0xFF22, 0x0);
+    write_mmu(gb, 0xFF23, 0xbf);
+    write_mmu(gb, 0xFF24, 0x77);
+    write_mmu(gb, 0xFF25, 0xf3);
+    write_mmu(gb, 0xFF26, 0xf1);
+    write_mmu(gb, 0xFF40, 0x91);
+    write_mmu(gb, 0xFF42, 0x0);
+    write_mmu(gb, 0xFF43, 0x0);
+    write_mmu(gb, 0xFF45, 0x0);
+    write_mmu(gb, 0xFF47, 0xfc);
+    write_mmu(gb, 0xFF48, 0xff);
+    write_mmu(gb, 0xFF49, 0xff);
+    write_mmu(gb, 0xFF4a, 0x0);
+    write_mmu(gb, 0xFF4b, 0x0);
+    write_mmu(gb, 0xFFFF, 0x0);
+
+    // FF55 - HDMA5, no H-Blank DMA active
+    gb->mmu.ram[0xFF55 - 0x8000] = 0xFF;
+    update_colors(gb, NULL);
+
+    schedule(gb, EVENT_LINE, 0);
 }
 
-void load_rom(char *path) {
+void load_rom(Gameboy *gb, char *path) {
+    memset(gb, 0, sizeof(Gameboy));
+
     printf("ROM path: %s\n", path);
 
     char *filename = malloc(strlen(path) + 1);
     strcpy(filename, path);
-    gameboy.mmu.mbc.filename = filename;
+    gb->mmu.mbc.filename = filename;
 
-    FILE *file = fopen(path, "rb");
-    if (!file) {
+    gb->mmu.mbc.rom = map_rom(path, &gb->mmu.mbc.rom_banks);
+    if (!gb->mmu.mbc.rom) {
         printf("Error reading rom file!");
         exit(1);
     }
 
-    fseek(file, 0, SEEK_END);
-    unsigned long fileLen = ftell(file);
-    fseek(file, 0, SEEK_SET);
-
-    gameboy.mmu.mbc.rom = malloc(fileLen + 1);
-
-    if (!gameboy.mmu.mbc.rom) {
-        fprintf(stderr, "Memory error!");
-        fclose(file);
-        return;
-    }
-
-    fread(gameboy.mmu.mbc.rom, fileLen, 1, file);
-    fclose(file);
+    gb->cgb = gb->mmu.mbc.rom[0x143] == 0x80 || gb->mmu.mbc.rom[0x143] == 0xC0;
+    init_mbc_ram(gb);
 
-    gameboy.cgb = gameboy.mmu.mbc.rom[0x143] == 0x80 || gameboy.mmu.mbc.rom[0x143] == 0xC0;
+    init(gb);
+}
 
-    init();
+void unload_rom(Gameboy *gb) {
+    stop_pipeline(gb);
+#ifdef JIT
+    jit_free(gb);
+#endif
+#ifdef PROFILE
+    profile_reset(gb);
+#endif
+    unmap_rom(gb->mmu.mbc.rom);
+    free(gb->mmu.mbc.filename);
+    free(gb->mmu.mbc.ram);
+    gb->mmu.mbc.rom = NULL;
+    gb->mmu.mbc.filename = NULL;
+    gb->mmu.mbc.ram = NULL;
 }
 
-void load_state() {
-    char filename[strlen(gameboy.mmu.mbc.filename) + 5];
-    stpcpy(filename, gameboy.mmu.mbc.filename);
+void load_state(Gameboy *gb) {
+    char filename[strlen(gb->mmu.mbc.filename) + 5];
+    stpcpy(filename, gb->mmu.mbc.filename);
     strcat(filename, ".sav");
 
     FILE *file = fopen(filename, "rb");
@@ -102,33 +110,74 @@ void load_state() {
         return;
     }
 
-    void *ptr_filename = gameboy.mmu.mbc.filename;
-    void *ptr_rom = gameboy.mmu.mbc.rom;
+    // the worker starts again from the loaded state
+    bool pipeline = gb->display.pipeline != NULL;
+    stop_pipeline(gb);
+
+    void *ptr_filename = gb->mmu.mbc.filename;
+    void *ptr_rom = gb->mmu.mbc.rom;
+    unsigned int rom_banks = gb->mmu.mbc.rom_banks;
+    void *ptr_ram = gb->mmu.mbc.ram;
+    unsigned int ram_size = gb->mmu.mbc.ram_size;
 
     // read ram state
-    fread(&gameboy.mmu, sizeof(Mmu), 1, file);
+    fread(&gb->mmu, sizeof(Mmu), 1, file);
 
     // read cpu state
-    fread(&cpu, sizeof(Cpu), 1, file);
+    fread(&gb->cpu, sizeof(Cpu), 1, file);
+
+    gb->mmu.mbc.filename = ptr_filename;
+    gb->mmu.mbc.rom = ptr_rom;
+    gb->mmu.mbc.rom_banks = rom_banks;
+    gb->mmu.mbc.ram = ptr_ram;
+    gb->mmu.mbc.ram_size = ram_size;
+
+    // read external ram
+    if (ram_size > 0)
+        fread(gb->mmu.mbc.ram, ram_size, 1, file);
+
+    map_memory(gb, 0, 0xFF);
+    update_interrupts(gb);
+
+    // events of the previous session never happened in the loaded one, DMA and serial transfers are dropped
+    cancel_all(gb);
+    load_timer(gb);
 
-    gameboy.mmu.mbc.filename = ptr_filename;
-    gameboy.mmu.mbc.rom = ptr_rom;
+    // FF44 - LY, the PPU starts the loaded line over
+    unsigned char ly = gb->mmu.ram[0xFF44 - 0x8000];
+    gb->display.line = ly < 154 ? ly : 0;
+    schedule(gb, EVENT_LINE, gb->scheduler.now);
+
+    memset(gb->display.tiles.valid, 0, sizeof(gb->display.tiles.valid));
+    update_colors(gb, NULL);
+    if (pipeline)
+        start_pipeline(gb);
+
+#ifdef BLOCK_CACHE
+    invalidate_blocks(gb);
+#endif
 
     fclose(file);
 }
 
-void save_state() {
-    char filename[strlen(gameboy.mmu.mbc.filename) + 5];
-    stpcpy(filename, gameboy.mmu.mbc.filename);
+void save_state(Gameboy *gb) {
+    char filename[strlen(gb->mmu.mbc.filename) + 5];
+    stpcpy(filename, gb->mmu.mbc.filename);
     strcat(filename, ".sav");
 
     FILE *file = fopen(filename, "wb");
 
+    sync_timer(gb);
+
     // save ram state
-    fwrite(&gameboy.mmu, sizeof(Mmu), 1, file);
+    fwrite(&gb->mmu, sizeof(Mmu), 1, file);
 
     // save cpu state
-    fwrite(&cpu, sizeof(Cpu), 1, file);
+    fwrite(&gb->cpu, sizeof(Cpu), 1, file);
+
+    // save external ram
+    if (gb->mmu.mbc.ram_size > 0)
+        fwrite(gb->mmu.mbc.ram, gb->mmu.mbc.ram_size, 1, file);
 
     fclose(file);
 }
@@ -7,25 +7,59 @@
 extern "C" {
 #endif
 
+#include "aot.h"
+#include "cache.h"
 #include "cpu.h"
+#include "display.h"
+#include "jit.h"
 #include "mmu.h"
+#include "pacer.h"
+#include "profile.h"
+#include "scheduler.h"
+#include "timer.h"
 
-typedef struct {
-    Mmu mmu;
+/*
+ * One emulated Game Boy. All emulation state lives in here, so any number of instances
+ * can run side by side, each one driven by at most one thread at a time.
+ *
+ * Ordered by how often the fields are touched: the CPU registers, the scheduler and the timer share the
+ * first cache lines, followed by the memory map and the IO handlers that every access goes through.
+ */
+struct Gameboy {
+    Cpu cpu;
+    Scheduler scheduler;
+    Timer timer;
     unsigned char controls;
-    Frame framebuffer;
     bool cgb;
-} Gameboy;
+    MemoryMap map;
+    IoPorts io;
+    Display display;
+    Mmu mmu;
+#ifdef BLOCK_CACHE
+    Cache cache;
+#endif
+#ifdef JIT
+    Jit jit;
+#endif
+#ifdef AOT
+    const AotTable *aot;
+#endif
+#ifdef PROFILE
+    Profile profile;
+#endif
+};
 
-extern Gameboy gameboy;
+// implemented by the frontend, receives every byte sent over the serial port
+void serial_print(Gameboy *gb, char c);
 
-void serial_print(char c);
+void load_rom(Gameboy *gb, char *path);
 
-void load_rom(char *path);
+// releases the ROM, instances of the same ROM share it until the last one is unloaded
+void unload_rom(Gameboy *gb);
 
-void load_state();
+void load_state(Gameboy *gb);
 
-void save_state();
+void save_state(Gameboy *gb);
 
 #ifdef __cplusplus
 }
@@ -14,13 +14,13 @@
  * H - Reset.
  * C - Contains old bit 7 data.
  */
-static inline unsigned char RLC(unsigned char value) {
+static inline unsigned char RLC(Cpu *cpu, unsigned char value) {
     bool c = (value >> 7) & 1;
     value = ((value << 1) | c) & 0xFF;
-    set_flag_Z(value == 0);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(c);
+    set_result(cpu, value);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, false);
+    set_flag_C(cpu, c);
     return value;
 }
 
@@ -36,13 +36,13 @@ static inline unsigned char RLC(unsigned char value) {
  * H - Reset.
  * C - Contains old bit 0 data
  */
-static inline unsigned char RRC(unsigned char value) {
+static inline unsigned char RRC(Cpu *cpu, unsigned char value) {
     bool c = value & 1;
     value = ((value >> 1) | (c << 7)) & 0xFF;
-    set_flag_Z(value == 0);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(c);
+    set_result(cpu, value);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, false);
+    set_flag_C(cpu, c);
     return value;
 }
 
@@ -58,13 +58,13 @@ static inline unsigned char RRC(unsigned char value) {
  * H - Reset.
  * C - Contains old bit 7 data.
  */
-static inline unsigned char RL(unsigned char value) {
+static inline unsigned char RL(Cpu *cpu, unsigned char value) {
     bool c = (value >> 7) & 1;
-    value = ((value << 1) | flag_C()) & 0xFF;
-    set_flag_Z(value == 0);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(c);
+    value = ((value << 1) | flag_C(cpu)) & 0xFF;
+    set_result(cpu, value);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, false);
+    set_flag_C(cpu, c);
     return value;
 }
 
@@ -80,13 +80,13 @@ static inline unsigned char RL(unsigned char value) {
  * H - Reset.
  * C - Contains old bit 0 data.
  */
-static inline unsigned char RR(unsigned char value) {
+static inline unsigned char RR(Cpu *cpu, unsigned char value) {
     bool c = value & 1;
-    value = ((value >> 1) | (flag_C() << 7)) & 0xFF;
-    set_flag_Z(value == 0);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(c);
+    value = ((value >> 1) | (flag_C(cpu) << 7)) & 0xFF;
+    set_result(cpu, value);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, false);
+    set_flag_C(cpu, c);
     return value;
 }
 
@@ -102,13 +102,13 @@ static inline unsigned char RR(unsigned char value) {
  * H - Reset.
  * C - Contains old bit 7 data.
  */
-static inline unsigned char SLA(unsigned char value) {
+static inline unsigned char SLA(Cpu *cpu, unsigned char value) {
     bool c = value >> 7 & 1;
     value = value << 1 & 0xFF;
-    set_flag_Z(value == 0);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(c);
+    set_result(cpu, value);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, false);
+    set_flag_C(cpu, c);
     return value;
 }
 
@@ -124,13 +124,13 @@ static inline unsigned char SLA(unsigned char value) {
  * H - Reset.
  * C - Contains old bit 0 data.
  */
-static inline unsigned char SRA(unsigned char value) {
+static inline unsigned char SRA(Cpu *cpu, unsigned char value) {
     bool c = value & 1;
     value = (value >> 1 | (value & (1 << 7))) & 0xFF;
-    set_flag_Z(value == 0);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(c);
+    set_result(cpu, value);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, false);
+    set_flag_C(cpu, c);
     return value;
 }
 
@@ -146,12 +146,12 @@ static inline unsigned char SRA(unsigned char value) {
  * H - Reset.
  * C - Reset.
  */
-static inline unsigned char SWAP(unsigned char value) {
+static inline unsigned char SWAP(Cpu *cpu, unsigned char value) {
     unsigned char res = (value << 4 | value >> 4) & 0xFF;
-    set_flag_Z(res == 0);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(false);
+    set_result(cpu, res);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, false);
+    set_flag_C(cpu, false);
     return res;
 }
 
@@ -167,12 +167,12 @@ static inline unsigned char SWAP(unsigned char value) {
  * H - Reset.
  * C - Contains old bit 0 data
  */
-static inline unsigned char SRL(unsigned char value) {
+static inline unsigned char SRL(Cpu *cpu, unsigned char value) {
     unsigned char res = value >> 1;
-    set_flag_Z(res == 0);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(value & 1);
+    set_result(cpu, res);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, false);
+    set_flag_C(cpu, value & 1);
     return res;
 }
 
@@ -188,10 +188,10 @@ static inline unsigned char SRL(unsigned char value) {
  * H - Set.
  * C - Not affected.
  */
-static inline unsigned char BIT(unsigned char value, unsigned char i) {
-    set_flag_Z((value >> i & 1) == 0);
-    set_flag_N(false);
-    set_flag_H(true);
+static inline unsigned char BIT(Cpu *cpu, unsigned char value, unsigned char i) {
+    set_result(cpu, value >> i & 1);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, true);
     return value;
 }
 
@@ -218,8 +218,8 @@ static inline unsigned char RES(unsigned char value, unsigned char i) { return v
 static inline unsigned char SET(unsigned char value, unsigned char i) { return value | 1 << i; }
 
 #define DEFINE_OP_REG(OP, REG) \
-        void OP ## _ ## REG() { \
-            cpu.REG = OP(cpu.REG); \
+        void OP ## _ ## REG(Gameboy *gb) { \
+            gb->cpu.REG = OP(&gb->cpu, gb->cpu.REG); \
         }
 
 #define DEFINE_CB_OPS(REG) \
@@ -233,16 +233,16 @@ static inline unsigned char SET(unsigned char value, unsigned char i) { return v
         DEFINE_OP_REG(SRL, REG)
 
 #define DEFINE_BIT_N_REG(N, REG) \
-        void BIT_ ## N ## _ ## REG() { \
-            cpu.REG = BIT(cpu.REG, N); \
+        void BIT_ ## N ## _ ## REG(Gameboy *gb) { \
+            gb->cpu.REG = BIT(&gb->cpu, gb->cpu.REG, N); \
         } \
         \
-        void RES_ ## N ## _ ## REG() { \
-            cpu.REG = RES(cpu.REG, N); \
+        void RES_ ## N ## _ ## REG(Gameboy *gb) { \
+            gb->cpu.REG = RES(gb->cpu.REG, N); \
         } \
         \
-        void SET_ ## N ## _ ## REG() { \
-            cpu.REG = SET(cpu.REG, N); \
+        void SET_ ## N ## _ ## REG(Gameboy *gb) { \
+            gb->cpu.REG = SET(gb->cpu.REG, N); \
         }
 
 #define DEFINE_BIT_REG(REG) \
@@ -268,8 +268,8 @@ DEFINE_CB(L)
 DEFINE_CB(A)
 
 #define DEFINE_OP_HL(OP) \
-        void OP ## _HL() { \
-            write_mmu(HL(), OP(read_mmu(HL()))); \
+        void OP ## _HL(Gameboy *gb) { \
+            write_mmu(gb, HL(&gb->cpu), OP(&gb->cpu, read_mmu(gb, HL(&gb->cpu)))); \
         }
 
 DEFINE_OP_HL(RLC)
@@ -282,16 +282,16 @@ DEFINE_OP_HL(SWAP)
 DEFINE_OP_HL(SRL)
 
 #define DEFINE_BIT_N_HL(N) \
-        void BIT_ ## N ## _HL() { \
-            write_mmu(HL(), BIT(read_mmu(HL()), N)); \
+        void BIT_ ## N ## _HL(Gameboy *gb) { \
+            write_mmu(gb, HL(&gb->cpu), BIT(&gb->cpu, read_mmu(gb, HL(&gb->cpu)), N)); \
         } \
         \
-        void RES_ ## N ## _HL() { \
-            write_mmu(HL(), RES(read_mmu(HL()), N)); \
+        void RES_ ## N ## _HL(Gameboy *gb) { \
+            write_mmu(gb, HL(&gb->cpu), RES(read_mmu(gb, HL(&gb->cpu)), N)); \
         } \
         \
-        void SET_ ## N ## _HL() { \
-            write_mmu(HL(), SET(read_mmu(HL()), N)); \
+        void SET_ ## N ## _HL(Gameboy *gb) { \
+            write_mmu(gb, HL(&gb->cpu), SET(read_mmu(gb, HL(&gb->cpu)), N)); \
         }
 
 DEFINE_BIT_N_HL(0)
@@ -3,8 +3,10 @@
 #ifndef LIBCBOY_CB_H
 #define LIBCBOY_CB_H
 
+typedef struct Gameboy Gameboy;
+
 #define DEFINE_CB_OP_REG(OP, REG) \
-        void OP ## _ ## REG();
+        void OP ## _ ## REG(Gameboy *gb);
 
 #define DEFINE_CB_OPS(REG) \
         DEFINE_CB_OP_REG(RLC, REG) \
@@ -17,9 +19,9 @@
         DEFINE_CB_OP_REG(SRL, REG)
 
 #define DEFINE_BIT_N_REG(N, REG) \
-        void BIT_ ## N ## _ ## REG(); \
-        void RES_ ## N ## _ ## REG(); \
-        void SET_ ## N ## _ ## REG();
+        void BIT_ ## N ## _ ## REG(Gameboy *gb); \
+        void RES_ ## N ## _ ## REG(Gameboy *gb); \
+        void SET_ ## N ## _ ## REG(Gameboy *gb);
 
 #define DEFINE_BIT_REG(REG) \
         DEFINE_BIT_N_REG(0, REG) \
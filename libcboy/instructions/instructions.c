@@ -7,10 +7,13 @@
  * Description:
  * No operation.
  */
-unsigned char NOP() { return 4; }
+unsigned char NOP(Gameboy *gb) {
+    (void)gb;
+    return 4;
+}
 
-unsigned char HALT() {
-    cpu.halt = true;
+unsigned char HALT(Gameboy *gb) {
+    gb->cpu.halt = true;
     return 4;
 }
 
@@ -22,10 +25,10 @@ unsigned char HALT() {
  * Use with:
  * nn = AF,BC,DE,HL
  */
-static inline void PUSH(unsigned short value) {
-    write_mmu(cpu.SP - 1, value >> 8);
-    write_mmu(cpu.SP - 2, value & 0xFF);
-    cpu.SP -= 2;
+static inline void PUSH(Gameboy *gb, unsigned short value) {
+    write_mmu(gb, gb->cpu.SP - 1, value >> 8);
+    write_mmu(gb, gb->cpu.SP - 2, value & 0xFF);
+    gb->cpu.SP -= 2;
 }
 
 /*
@@ -36,9 +39,9 @@ static inline void PUSH(unsigned short value) {
  * Use with:
  * nn = AF,BC,DE,HL
  */
-static inline unsigned short POP() {
-    unsigned short value = (read_mmu(cpu.SP + 1) << 8 | read_mmu(cpu.SP)) & 0xFFFF;
-    cpu.SP += 2;
+static inline unsigned short POP(Gameboy *gb) {
+    unsigned short value = (read_mmu(gb, gb->cpu.SP + 1) << 8 | read_mmu(gb, gb->cpu.SP)) & 0xFFFF;
+    gb->cpu.SP += 2;
     return value;
 }
 
@@ -49,38 +52,38 @@ static inline unsigned short POP() {
  * Use with:
  * nn = two byte immediate value. (LS byte first.)
  */
-unsigned char JP(unsigned short addr) {
-    cpu.PC = addr;
+unsigned char JP(Gameboy *gb, unsigned short addr) {
+    gb->cpu.PC = addr;
     return 16;
 }
 
-unsigned char JP_NZ_a16(unsigned short value) {
-    if (!flag_Z()) {
-        cpu.PC = value;
+unsigned char JP_NZ_a16(Gameboy *gb, unsigned short value) {
+    if (!flag_Z(&gb->cpu)) {
+        gb->cpu.PC = value;
         return 16;
     }
     return 12;
 }
 
-unsigned char JP_NC_a16(unsigned short value) {
-    if (!flag_C()) {
-        cpu.PC = value;
+unsigned char JP_NC_a16(Gameboy *gb, unsigned short value) {
+    if (!flag_C(&gb->cpu)) {
+        gb->cpu.PC = value;
         return 16;
     }
     return 12;
 }
 
-unsigned char JP_C_a16(unsigned short value) {
-    if (flag_C()) {
-        cpu.PC = value;
+unsigned char JP_C_a16(Gameboy *gb, unsigned short value) {
+    if (flag_C(&gb->cpu)) {
+        gb->cpu.PC = value;
         return 16;
     }
     return 12;
 }
 
-unsigned char JP_Z_a16(unsigned short value) {
-    if (flag_Z()) {
-        cpu.PC = value;
+unsigned char JP_Z_a16(Gameboy *gb, unsigned short value) {
+    if (flag_Z(&gb->cpu)) {
+        gb->cpu.PC = value;
         return 16;
     }
     return 12;
@@ -91,8 +94,8 @@ unsigned char JP_Z_a16(unsigned short value) {
  * Description:
  * Jump to address contained in HL.
  */
-unsigned char JP_HL() {
-    cpu.PC = HL();
+unsigned char JP_HL(Gameboy *gb) {
+    gb->cpu.PC = HL(&gb->cpu);
     return 4;
 }
 
@@ -103,42 +106,42 @@ unsigned char JP_HL() {
  * Use with:
  * n = one byte signed immediate value
  */
-static inline void JR(unsigned char value) { cpu.PC += (value ^ 0x80) - 0x80; }
+static inline void JR(Gameboy *gb, unsigned char value) { gb->cpu.PC += (value ^ 0x80) - 0x80; }
 
-unsigned char JR_C_r8(unsigned char value) {
-    if (flag_C()) {
-        JR(value);
+unsigned char JR_C_r8(Gameboy *gb, unsigned char value) {
+    if (flag_C(&gb->cpu)) {
+        JR(gb, value);
         return 12;
     }
     return 8;
 }
 
-unsigned char JR_NC_r8(unsigned char value) {
-    if (flag_C() == 0) {
-        JR(value);
+unsigned char JR_NC_r8(Gameboy *gb, unsigned char value) {
+    if (flag_C(&gb->cpu) == 0) {
+        JR(gb, value);
         return 12;
     }
     return 8;
 }
 
-unsigned char JR_NZ_r8(unsigned char value) {
-    if (flag_Z() == 0) {
-        JR(value);
+unsigned char JR_NZ_r8(Gameboy *gb, unsigned char value) {
+    if (flag_Z(&gb->cpu) == 0) {
+        JR(gb, value);
         return 12;
     }
     return 8;
 }
 
-unsigned char JR_Z_r8(unsigned char value) {
-    if (flag_Z()) {
-        JR(value);
+unsigned char JR_Z_r8(Gameboy *gb, unsigned char value) {
+    if (flag_Z(&gb->cpu)) {
+        JR(gb, value);
         return 12;
     }
     return 8;
 }
 
-unsigned char JR_r8(unsigned char value) {
-    JR(value);
+unsigned char JR_r8(Gameboy *gb, unsigned char value) {
+    JR(gb, value);
     return 12;
 }
 
@@ -150,36 +153,36 @@ unsigned char JR_r8(unsigned char value) {
  * Use with:
  * nn = two byte immediate value. (LS byte first.)
  */
-unsigned char CALL_a16(unsigned short addr) {
-    PUSH(cpu.PC);
-    cpu.PC = addr;
+unsigned char CALL_a16(Gameboy *gb, unsigned short addr) {
+    PUSH(gb, gb->cpu.PC);
+    gb->cpu.PC = addr;
     return 24;
 }
 
-unsigned char CALL_Z_a16(unsigned short addr) {
-    if (flag_Z()) {
-        return CALL_a16(addr);
+unsigned char CALL_Z_a16(Gameboy *gb, unsigned short addr) {
+    if (flag_Z(&gb->cpu)) {
+        return CALL_a16(gb, addr);
     }
     return 12;
 }
 
-unsigned char CALL_NZ_a16(unsigned short addr) {
-    if (!flag_Z()) {
-        return CALL_a16(addr);
+unsigned char CALL_NZ_a16(Gameboy *gb, unsigned short addr) {
+    if (!flag_Z(&gb->cpu)) {
+        return CALL_a16(gb, addr);
     }
     return 12;
 }
 
-unsigned char CALL_NC_a16(unsigned short addr) {
-    if (!flag_C()) {
-        return CALL_a16(addr);
+unsigned char CALL_NC_a16(Gameboy *gb, unsigned short addr) {
+    if (!flag_C(&gb->cpu)) {
+        return CALL_a16(gb, addr);
     }
     return 12;
 }
 
-unsigned char CALL_C_a16(unsigned short addr) {
-    if (flag_C()) {
-        return CALL_a16(addr);
+unsigned char CALL_C_a16(Gameboy *gb, unsigned short addr) {
+    if (flag_C(&gb->cpu)) {
+        return CALL_a16(gb, addr);
     }
     return 12;
 }
@@ -189,38 +192,38 @@ unsigned char CALL_C_a16(unsigned short addr) {
  * Description:
  * Pop two bytes from stack & jump to that address.
  */
-unsigned char RET() {
-    cpu.PC = POP();
+unsigned char RET(Gameboy *gb) {
+    gb->cpu.PC = POP(gb);
     return 16;
 }
 
-unsigned char RET_C() {
-    if (flag_C()) {
-        cpu.PC = POP();
+unsigned char RET_C(Gameboy *gb) {
+    if (flag_C(&gb->cpu)) {
+        gb->cpu.PC = POP(gb);
         return 20;
     }
     return 8;
 }
 
-unsigned char RET_NC() {
-    if (!flag_C()) {
-        cpu.PC = POP();
+unsigned char RET_NC(Gameboy *gb) {
+    if (!flag_C(&gb->cpu)) {
+        gb->cpu.PC = POP(gb);
         return 20;
     }
     return 8;
 }
 
-unsigned char RET_Z() {
-    if (flag_Z()) {
-        cpu.PC = POP();
+unsigned char RET_Z(Gameboy *gb) {
+    if (flag_Z(&gb->cpu)) {
+        gb->cpu.PC = POP(gb);
         return 20;
     }
     return 8;
 }
 
-unsigned char RET_NZ() {
-    if (!flag_Z()) {
-        cpu.PC = POP();
+unsigned char RET_NZ(Gameboy *gb) {
+    if (!flag_Z(&gb->cpu)) {
+        gb->cpu.PC = POP(gb);
         return 20;
     }
     return 8;
@@ -232,15 +235,15 @@ unsigned char RET_NZ() {
  * Pop two bytes from stack & jump to that address then
  * enable interrupts.
  */
-unsigned char RETI() {
-    cpu.PC = POP();
-    cpu.ime = true;
+unsigned char RETI(Gameboy *gb) {
+    gb->cpu.PC = POP(gb);
+    gb->cpu.ime = true;
     return 16;
 }
 
-static inline unsigned char RST(unsigned char addr) {
-    PUSH(cpu.PC);
-    cpu.PC = addr;
+static inline unsigned char RST(Gameboy *gb, unsigned char addr) {
+    PUSH(gb, gb->cpu.PC);
+    gb->cpu.PC = addr;
     return 16;
 }
 
@@ -256,12 +259,12 @@ static inline unsigned char RST(unsigned char addr) {
  * H - Set if carry from bit 3.
  * C - Set if carry from bit 7.
  */
-static inline unsigned char ADD(unsigned char a, unsigned char b) {
+static inline unsigned char ADD(Cpu *cpu, unsigned char a, unsigned char b) {
     unsigned char res = (a + b) & 0xFF;
-    set_flag_Z(res == 0);
-    set_flag_N(false);
-    set_flag_H((a & 0xF) + (b & 0xF) > 0xF);
-    set_flag_C(a + b > 0xFF);
+    set_result(cpu, res);
+    set_flag_N(cpu, false);
+    set_half_carry(cpu, HALF_ADD, a, b, false);
+    set_flag_C(cpu, a + b > 0xFF);
     return res;
 }
 
@@ -277,11 +280,11 @@ static inline unsigned char ADD(unsigned char a, unsigned char b) {
  * H - Set if carry from bit 11.
  * C - Set if carry from bit 15.
  */
-static inline unsigned short ADD_HL_n(unsigned short a, unsigned short b) {
+static inline unsigned short ADD_HL_n(Cpu *cpu, unsigned short a, unsigned short b) {
     unsigned short res = (a + b) & 0xFFFF;
-    set_flag_N(false);
-    set_flag_H((a & 0xFFF) + (b & 0xFFF) > 0xFFF);
-    set_flag_C(a + b > 0xFFFF);
+    set_flag_N(cpu, false);
+    set_half_carry(cpu, HALF_ADD16, a, b, false);
+    set_flag_C(cpu, a + b > 0xFFFF);
     return res;
 }
 
@@ -297,13 +300,13 @@ static inline unsigned short ADD_HL_n(unsigned short a, unsigned short b) {
  * H - Set or reset according to operation.
  * C - Set or reset according to operation.
  */
-unsigned char ADD_SP_r8(unsigned char value) {
-    unsigned short res = (cpu.SP + (char)value) & 0xFFFF;
-    set_flag_Z(false);
-    set_flag_N(false);
-    set_flag_H((cpu.SP & 0xF) + (value & 0xF) > 0xF);
-    set_flag_C((cpu.SP & 0xFF) + (value & 0xFF) > 0xFF);
-    cpu.SP = res;
+unsigned char ADD_SP_r8(Gameboy *gb, unsigned char value) {
+    unsigned short res = (gb->cpu.SP + (char)value) & 0xFFFF;
+    set_flag_Z(&gb->cpu, false);
+    set_flag_N(&gb->cpu, false);
+    set_half_carry(&gb->cpu, HALF_ADD, gb->cpu.SP, value, false);
+    set_flag_C(&gb->cpu, (gb->cpu.SP & 0xFF) + (value & 0xFF) > 0xFF);
+    gb->cpu.SP = res;
     return 16;
 }
 
@@ -319,12 +322,13 @@ unsigned char ADD_SP_r8(unsigned char value) {
  * H - Set if carry from bit 3.
  * C - Set if carry from bit 7.
  */
-static inline unsigned char ADC(unsigned char a, unsigned char b) {
-    unsigned char res = (a + b + flag_C()) & 0xFF;
-    set_flag_Z(res == 0);
-    set_flag_N(false);
-    set_flag_H((a & 0xF) + (b & 0xF) + flag_C() > 0xF);
-    set_flag_C(a + b + flag_C() > 0xFF);
+static inline unsigned char ADC(Cpu *cpu, unsigned char a, unsigned char b) {
+    bool carry = flag_C(cpu);
+    unsigned char res = (a + b + carry) & 0xFF;
+    set_result(cpu, res);
+    set_flag_N(cpu, false);
+    set_half_carry(cpu, HALF_ADD, a, b, carry);
+    set_flag_C(cpu, a + b + carry > 0xFF);
     return res;
 }
 
@@ -340,12 +344,12 @@ static inline unsigned char ADC(unsigned char a, unsigned char b) {
  * H - Set if no borrow from bit 4.
  * C - Set if no borrow.
  */
-static inline unsigned char SUB(unsigned char a, unsigned char b) {
+static inline unsigned char SUB(Cpu *cpu, unsigned char a, unsigned char b) {
     unsigned char res = (a - b) & 0xFF;
-    set_flag_Z(res == 0);
-    set_flag_N(true);
-    set_flag_H((a & 0xF) < (b & 0xF));
-    set_flag_C(a < b);
+    set_result(cpu, res);
+    set_flag_N(cpu, true);
+    set_half_carry(cpu, HALF_SUB, a, b, false);
+    set_flag_C(cpu, a < b);
     return res;
 }
 
@@ -361,12 +365,13 @@ static inline unsigned char SUB(unsigned char a, unsigned char b) {
  * H - Set if no borrow from bit 4.
  * C - Set if no borrow.
  */
-static inline unsigned char SBC(unsigned char a, unsigned char b) {
-    unsigned char res = (a - b - flag_C()) & 0xFF;
-    set_flag_Z(res == 0);
-    set_flag_N(true);
-    set_flag_H((a & 0xF) < (b & 0xF) + flag_C());
-    set_flag_C(a < b + flag_C());
+static inline unsigned char SBC(Cpu *cpu, unsigned char a, unsigned char b) {
+    bool carry = flag_C(cpu);
+    unsigned char res = (a - b - carry) & 0xFF;
+    set_result(cpu, res);
+    set_flag_N(cpu, true);
+    set_half_carry(cpu, HALF_SUB, a, b, carry);
+    set_flag_C(cpu, a < b + carry);
     return res;
 }
 
@@ -382,12 +387,12 @@ static inline unsigned char SBC(unsigned char a, unsigned char b) {
  * H - Set.
  * C - Reset.
  */
-static inline unsigned char AND(unsigned char a, unsigned char b) {
+static inline unsigned char AND(Cpu *cpu, unsigned char a, unsigned char b) {
     unsigned char res = a & b;
-    set_flag_Z(res == 0);
-    set_flag_N(false);
-    set_flag_H(true);
-    set_flag_C(false);
+    set_result(cpu, res);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, true);
+    set_flag_C(cpu, false);
     return res;
 }
 
@@ -403,11 +408,11 @@ static inline unsigned char AND(unsigned char a, unsigned char b) {
  * H - Set if carry from bit 3.
  * C - Not affected.
  */
-static inline unsigned char INC(unsigned char reg) {
-    set_flag_H(((reg & 0xF) + 1) & 0x10);
+static inline unsigned char INC(Cpu *cpu, unsigned char reg) {
+    set_half_carry(cpu, HALF_ADD, reg, 1, false);
     reg = (reg + 1) & 0xFF;
-    set_flag_Z(reg == 0);
-    set_flag_N(false);
+    set_result(cpu, reg);
+    set_flag_N(cpu, false);
     return reg;
 }
 
@@ -423,11 +428,11 @@ static inline unsigned char INC(unsigned char reg) {
  * H - Set if no borrow from bit 4.
  * C - Not affected.
  */
-static inline unsigned char DEC(unsigned char reg) {
-    set_flag_H((reg & 0xF) - 1 < 0);
+static inline unsigned char DEC(Cpu *cpu, unsigned char reg) {
+    set_half_carry(cpu, HALF_SUB, reg, 1, false);
     reg = (reg - 1) & 0xFF;
-    set_flag_Z(reg == 0);
-    set_flag_N(true);
+    set_result(cpu, reg);
+    set_flag_N(cpu, true);
     return reg;
 }
 
@@ -443,12 +448,12 @@ static inline unsigned char DEC(unsigned char reg) {
  * H - Reset.
  * C - Reset.
  */
-static inline unsigned char OR(unsigned char a, unsigned char b) {
+static inline unsigned char OR(Cpu *cpu, unsigned char a, unsigned char b) {
     unsigned char res = a | b;
-    set_flag_Z(res == 0);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(false);
+    set_result(cpu, res);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, false);
+    set_flag_C(cpu, false);
     return res;
 }
 
@@ -464,12 +469,12 @@ static inline unsigned char OR(unsigned char a, unsigned char b) {
  * H - Reset.
  * C - Reset.
  */
-static inline unsigned char XOR(unsigned char a, unsigned char b) {
+static inline unsigned char XOR(Cpu *cpu, unsigned char a, unsigned char b) {
     unsigned char res = a ^ b;
-    set_flag_Z(res == 0);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(false);
+    set_result(cpu, res);
+    set_flag_N(cpu, false);
+    set_flag_H(cpu, false);
+    set_flag_C(cpu, false);
     return res;
 }
 
@@ -487,12 +492,12 @@ static inline unsigned char XOR(unsigned char a, unsigned char b) {
  * H - Set if no borrow from bit 4.
  * C - Set for no borrow. (Set if A < n.)
  */
-static inline unsigned char CP(unsigned char a, unsigned char b) {
+static inline unsigned char CP(Cpu *cpu, unsigned char a, unsigned char b) {
     unsigned char res = a - b;
-    set_flag_Z(res == 0);
-    set_flag_N(true);
-    set_flag_H((a & 0xF) < (b & 0xF));
-    set_flag_C(a < b);
+    set_result(cpu, res);
+    set_flag_N(cpu, true);
+    set_half_carry(cpu, HALF_SUB, a, b, false);
+    set_flag_C(cpu, a < b);
     return a;
 }
 
@@ -506,13 +511,13 @@ static inline unsigned char CP(unsigned char a, unsigned char b) {
  * H - Reset.
  * C - Contains old bit 7 data.
  */
-unsigned char RLCA() {
-    bool c = cpu.A >> 7 & 1;
-    cpu.A = (cpu.A << 1 | c) & 0xFF;
-    set_flag_Z(false);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(c);
+unsigned char RLCA(Gameboy *gb) {
+    bool c = gb->cpu.A >> 7 & 1;
+    gb->cpu.A = (gb->cpu.A << 1 | c) & 0xFF;
+    set_flag_Z(&gb->cpu, false);
+    set_flag_N(&gb->cpu, false);
+    set_flag_H(&gb->cpu, false);
+    set_flag_C(&gb->cpu, c);
     return 4;
 }
 
@@ -526,13 +531,13 @@ unsigned char RLCA() {
  * H - Reset.
  * C - Contains old bit 0 data.
  */
-unsigned char RRCA() {
-    bool c = cpu.A & 1;
-    cpu.A = ((cpu.A >> 1) | c << 7) & 0xFF;
-    set_flag_Z(false);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(c);
+unsigned char RRCA(Gameboy *gb) {
+    bool c = gb->cpu.A & 1;
+    gb->cpu.A = ((gb->cpu.A >> 1) | c << 7) & 0xFF;
+    set_flag_Z(&gb->cpu, false);
+    set_flag_N(&gb->cpu, false);
+    set_flag_H(&gb->cpu, false);
+    set_flag_C(&gb->cpu, c);
     return 4;
 }
 
@@ -546,13 +551,13 @@ unsigned char RRCA() {
  * H - Reset.
  * C - Contains old bit 7 data.
  */
-unsigned char RLA() {
-    bool c = (cpu.A >> 7) & 1;
-    cpu.A = ((cpu.A << 1) | flag_C()) & 0xFF;
-    set_flag_Z(false);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(c);
+unsigned char RLA(Gameboy *gb) {
+    bool c = (gb->cpu.A >> 7) & 1;
+    gb->cpu.A = ((gb->cpu.A << 1) | flag_C(&gb->cpu)) & 0xFF;
+    set_flag_Z(&gb->cpu, false);
+    set_flag_N(&gb->cpu, false);
+    set_flag_H(&gb->cpu, false);
+    set_flag_C(&gb->cpu, c);
     return 4;
 }
 
@@ -566,13 +571,13 @@ unsigned char RLA() {
  * H - Reset.
  * C - Contains old bit 0 data.
  */
-unsigned char RRA() {
-    unsigned char c = cpu.A & 1;
-    cpu.A = ((cpu.A >> 1) | (flag_C() << 7)) & 0xFF;
-    set_flag_Z(false);
-    set_flag_N(false);
-    set_flag_H(false);
-    set_flag_C(c);
+unsigned char RRA(Gameboy *gb) {
+    unsigned char c = gb->cpu.A & 1;
+    gb->cpu.A = ((gb->cpu.A >> 1) | (flag_C(&gb->cpu) << 7)) & 0xFF;
+    set_flag_Z(&gb->cpu, false);
+    set_flag_N(&gb->cpu, false);
+    set_flag_H(&gb->cpu, false);
+    set_flag_C(&gb->cpu, c);
     return 4;
 }
 
@@ -589,14 +594,14 @@ unsigned char RRA() {
  * H - Reset.
  * C - Set or reset according to operation.
  */
-unsigned char DAA() {
-    unsigned char t = cpu.A;
+unsigned char DAA(Gameboy *gb) {
+    unsigned char t = gb->cpu.A;
     unsigned char corr = 0;
-    if (flag_H())
+    if (flag_H(&gb->cpu))
         corr |= 0x06;
-    if (flag_C())
+    if (flag_C(&gb->cpu))
         corr |= 0x60;
-    if (flag_N())
+    if (flag_N(&gb->cpu))
         t -= corr;
     else {
         if ((t & 0x0F) > 0x09)
@@ -605,10 +610,10 @@ unsigned char DAA() {
             corr |= 0x60;
         t += corr;
     }
-    set_flag_Z((t & 0xFF) == 0);
-    set_flag_H(false);
-    set_flag_C((corr & 0x60) != 0);
-    cpu.A = t & 0xFF;
+    set_result(&gb->cpu, t);
+    set_flag_H(&gb->cpu, false);
+    set_flag_C(&gb->cpu, (corr & 0x60) != 0);
+    gb->cpu.A = t & 0xFF;
     return 4;
 }
 
@@ -622,10 +627,10 @@ unsigned char DAA() {
  * H - Set.
  * C - Not affected.
  */
-unsigned char CPL() {
-    cpu.A = ~cpu.A & 0xFF;
-    set_flag_N(true);
-    set_flag_H(true);
+unsigned char CPL(Gameboy *gb) {
+    gb->cpu.A = ~gb->cpu.A & 0xFF;
+    set_flag_N(&gb->cpu, true);
+    set_flag_H(&gb->cpu, true);
     return 4;
 }
 
@@ -639,10 +644,10 @@ unsigned char CPL() {
  * H - Reset.
  * C - Set.
  */
-unsigned char SCF() {
-    set_flag_C(true);
-    set_flag_N(false);
-    set_flag_H(false);
+unsigned char SCF(Gameboy *gb) {
+    set_flag_C(&gb->cpu, true);
+    set_flag_N(&gb->cpu, false);
+    set_flag_H(&gb->cpu, false);
     return 4;
 }
 
@@ -658,30 +663,30 @@ unsigned char SCF() {
  * H - Reset.
  * C - Complemented.
  */
-unsigned char CCF() {
-    set_flag_C(!flag_C());
-    set_flag_N(false);
-    set_flag_H(false);
+unsigned char CCF(Gameboy *gb) {
+    set_flag_C(&gb->cpu, !flag_C(&gb->cpu));
+    set_flag_N(&gb->cpu, false);
+    set_flag_H(&gb->cpu, false);
     return 4;
 }
 
-unsigned char LD_A_BC() {
-    cpu.A = read_mmu(BC());
+unsigned char LD_A_BC(Gameboy *gb) {
+    gb->cpu.A = read_mmu(gb, BC(&gb->cpu));
     return 8;
 }
 
-unsigned char LD_BC_A() {
-    write_mmu(BC(), cpu.A);
+unsigned char LD_BC_A(Gameboy *gb) {
+    write_mmu(gb, BC(&gb->cpu), gb->cpu.A);
     return 8;
 }
 
-unsigned char LD_A_DE() {
-    cpu.A = read_mmu(DE());
+unsigned char LD_A_DE(Gameboy *gb) {
+    gb->cpu.A = read_mmu(gb, DE(&gb->cpu));
     return 8;
 }
 
-unsigned char LD_DE_A() {
-    write_mmu(DE(), cpu.A);
+unsigned char LD_DE_A(Gameboy *gb) {
+    write_mmu(gb, DE(&gb->cpu), gb->cpu.A);
     return 8;
 }
 
@@ -691,9 +696,9 @@ unsigned char LD_DE_A() {
  * Put A into memory address HL. Increment HL.
  * Same as: LD (HL),A - INC HL
  */
-unsigned char LDI_HL_A() {
-    write_mmu(HL(), cpu.A);
-    set_HL((HL() + 1) & 0xFFFF);
+unsigned char LDI_HL_A(Gameboy *gb) {
+    write_mmu(gb, HL(&gb->cpu), gb->cpu.A);
+    set_HL(&gb->cpu, (HL(&gb->cpu) + 1) & 0xFFFF);
     return 8;
 }
 
@@ -703,9 +708,9 @@ unsigned char LDI_HL_A() {
  * Put value at address HL into A. Increment HL.
  * Same as: LD A,(HL) - INC HL
  */
-unsigned char LDI_A_HL() {
-    cpu.A = read_mmu(HL());
-    set_HL((HL() + 1) & 0xFFFF);
+unsigned char LDI_A_HL(Gameboy *gb) {
+    gb->cpu.A = read_mmu(gb, HL(&gb->cpu));
+    set_HL(&gb->cpu, (HL(&gb->cpu) + 1) & 0xFFFF);
     return 8;
 }
 
@@ -715,9 +720,9 @@ unsigned char LDI_A_HL() {
  * Put A into memory address HL. Decrement HL.
  * Same as: LD (HL),A - DEC HL
  */
-unsigned char LDD_HL_A() {
-    write_mmu(HL(), cpu.A);
-    set_HL(HL() - 1);
+unsigned char LDD_HL_A(Gameboy *gb) {
+    write_mmu(gb, HL(&gb->cpu), gb->cpu.A);
+    set_HL(&gb->cpu, HL(&gb->cpu) - 1);
     return 8;
 }
 
@@ -727,9 +732,9 @@ unsigned char LDD_HL_A() {
  * Put value at address HL into A. Decrement HL.
  * Same as: LD A,(HL) - DEC HL
  */
-unsigned char LDD_A_HL() {
-    cpu.A = read_mmu(HL());
-    set_HL((HL() - 1) & 0xFFFF);
+unsigned char LDD_A_HL(Gameboy *gb) {
+    gb->cpu.A = read_mmu(gb, HL(&gb->cpu));
+    set_HL(&gb->cpu, (HL(&gb->cpu) - 1) & 0xFFFF);
     return 8;
 }
 
@@ -740,8 +745,8 @@ unsigned char LDD_A_HL() {
  * Use with:
  * n = one byte immediate value.
  */
-unsigned char LDH_n_A(unsigned char addr) {
-    write_mmu(0xFF00 + addr, cpu.A);
+unsigned char LDH_n_A(Gameboy *gb, unsigned char addr) {
+    write_mmu(gb, 0xFF00 + addr, gb->cpu.A);
     return 12;
 }
 
@@ -752,8 +757,8 @@ unsigned char LDH_n_A(unsigned char addr) {
  * Use with:
  * n = one byte immediate value.
  */
-unsigned char LDH_A_n(unsigned char addr) {
-    cpu.A = read_mmu(0xFF00 + addr);
+unsigned char LDH_A_n(Gameboy *gb, unsigned char addr) {
+    gb->cpu.A = read_mmu(gb, 0xFF00 + addr);
     return 12;
 }
 
@@ -763,8 +768,8 @@ unsigned char LDH_A_n(unsigned char addr) {
  * Put value at address $FF00 + register C into A.
  * Same as: LD A,($FF00+C)
  */
-unsigned char LD_A_Cp() {
-    cpu.A = read_mmu(0xFF00 + cpu.C);
+unsigned char LD_A_Cp(Gameboy *gb) {
+    gb->cpu.A = read_mmu(gb, 0xFF00 + gb->cpu.C);
     return 4;
 }
 
@@ -773,8 +778,8 @@ unsigned char LD_A_Cp() {
  * Description:
  * Put A into address $FF00 + register C.
  */
-unsigned char LD_Cp_A() {
-    write_mmu(0xFF00 + cpu.C, cpu.A);
+unsigned char LD_Cp_A(Gameboy *gb) {
+    write_mmu(gb, 0xFF00 + gb->cpu.C, gb->cpu.A);
     return 8;
 }
 
@@ -785,9 +790,9 @@ unsigned char LD_Cp_A() {
  * Use with:
  * nn = two byte immediate address.
  */
-unsigned char LD_a16_SP(unsigned short addr) {
-    write_mmu(addr, cpu.SP & 0xFF);
-    write_mmu(addr + 1, cpu.SP >> 8 & 0xFF);
+unsigned char LD_a16_SP(Gameboy *gb, unsigned short addr) {
+    write_mmu(gb, addr, gb->cpu.SP & 0xFF);
+    write_mmu(gb, addr + 1, gb->cpu.SP >> 8 & 0xFF);
     return 20;
 }
 
@@ -798,8 +803,8 @@ unsigned char LD_a16_SP(unsigned short addr) {
  * Use with:
  * nn = two byte immediate value. (LS byte first.)
  */
-unsigned char LD_a16_A(unsigned short value) {
-    write_mmu(value, cpu.A);
+unsigned char LD_a16_A(Gameboy *gb, unsigned short value) {
+    write_mmu(gb, value, gb->cpu.A);
     return 16;
 }
 
@@ -810,8 +815,8 @@ unsigned char LD_a16_A(unsigned short value) {
  * Use with:
  * nn = two byte immediate value. (LS byte first.)
  */
-unsigned char LD_A_a16(unsigned short value) {
-    cpu.A = read_mmu(value);
+unsigned char LD_A_a16(Gameboy *gb, unsigned short value) {
+    gb->cpu.A = read_mmu(gb, value);
     return 16;
 }
 
@@ -827,13 +832,13 @@ unsigned char LD_A_a16(unsigned short value) {
  * H - Set or reset according to operation.
  * C - Set or reset according to operation.
  */
-unsigned char LD_HL_SP_r8(unsigned char value) {
-    unsigned short res = cpu.SP + (char)value;
-    set_flag_Z(false);
-    set_flag_N(false);
-    set_flag_H((cpu.SP & 0xF) + (value & 0xF) > 0xF);
-    set_flag_C((cpu.SP & 0xFF) + (value & 0xFF) > 0xFF);
-    set_HL(res & 0xFFFF);
+unsigned char LD_HL_SP_r8(Gameboy *gb, unsigned char value) {
+    unsigned short res = gb->cpu.SP + (char)value;
+    set_flag_Z(&gb->cpu, false);
+    set_flag_N(&gb->cpu, false);
+    set_half_carry(&gb->cpu, HALF_ADD, gb->cpu.SP, value, false);
+    set_flag_C(&gb->cpu, (gb->cpu.SP & 0xFF) + (value & 0xFF) > 0xFF);
+    set_HL(&gb->cpu, res & 0xFFFF);
     return 12;
 }
 
@@ -842,8 +847,8 @@ unsigned char LD_HL_SP_r8(unsigned char value) {
  * Description:
  * Put HL into Stack Pointer (SP).
  */
-unsigned char LD_SP_HL() {
-    cpu.SP = HL();
+unsigned char LD_SP_HL(Gameboy *gb) {
+    gb->cpu.SP = HL(&gb->cpu);
     return 8;
 }
 
@@ -856,8 +861,8 @@ unsigned char LD_SP_HL() {
  * Flags affected:
  * None.
  */
-unsigned char DI() {
-    cpu.ime = false;
+unsigned char DI(Gameboy *gb) {
+    gb->cpu.ime = false;
     return 4;
 }
 
@@ -870,54 +875,54 @@ unsigned char DI() {
  * Flags affected:
  * None.
  */
-unsigned char EI() {
-    cpu.ime = true;
+unsigned char EI(Gameboy *gb) {
+    gb->cpu.ime = true;
     return 4;
 }
 
 // INC (HL)
-unsigned char INC_HLp() {
-    write_mmu(HL(), INC(read_mmu(HL())));
+unsigned char INC_HLp(Gameboy *gb) {
+    write_mmu(gb, HL(&gb->cpu), INC(&gb->cpu, read_mmu(gb, HL(&gb->cpu))));
     return 12;
 }
 
 // DEC (HL)
-unsigned char DEC_HLp() {
-    write_mmu(HL(), DEC(read_mmu(HL())));
+unsigned char DEC_HLp(Gameboy *gb) {
+    write_mmu(gb, HL(&gb->cpu), DEC(&gb->cpu, read_mmu(gb, HL(&gb->cpu))));
     return 12;
 }
 
 // LD (HL),d8
-unsigned char LD_HLp_d8(unsigned char arg) {
-    write_mmu(HL(), arg);
+unsigned char LD_HLp_d8(Gameboy *gb, unsigned char arg) {
+    write_mmu(gb, HL(&gb->cpu), arg);
     return 12;
 }
 
 // LD r16,d16
 #define DEFINE_r16_d16(REG) \
-        unsigned char LD_ ## REG ## _d16(unsigned short arg) { \
-            set_##REG(arg); \
+        unsigned char LD_ ## REG ## _d16(Gameboy *gb, unsigned short arg) { \
+            set_##REG(&gb->cpu, arg); \
             return 12; \
         }
 
 // INC r8
 #define DEFINE_INC(REG) \
-        unsigned char INC_ ## REG () { \
-            set_##REG(REG() + 1); \
+        unsigned char INC_ ## REG(Gameboy *gb) { \
+            set_##REG(&gb->cpu, REG(&gb->cpu) + 1); \
             return 8; \
         }
 
 // DEC r8
 #define DEFINE_DEC(REG) \
-        unsigned char DEC_ ## REG () { \
-            set_##REG(REG() - 1); \
+        unsigned char DEC_ ## REG(Gameboy *gb) { \
+            set_##REG(&gb->cpu, REG(&gb->cpu) - 1); \
             return 8; \
         }
 
 // ADD HL,r16
 #define DEFINE_ADD_HL_r16(REG) \
-        unsigned char ADD_HL_ ## REG () { \
-            set_HL(ADD_HL_n(HL(), REG())); \
+        unsigned char ADD_HL_ ## REG(Gameboy *gb) { \
+            set_HL(&gb->cpu, ADD_HL_n(&gb->cpu, HL(&gb->cpu), REG(&gb->cpu))); \
             return 8; \
         }
 
@@ -934,15 +939,15 @@ DEFINE_r16(SP)
 
 // POP r16
 #define DEFINE_POP_r16(REG) \
-        unsigned char POP_ ## REG () { \
-            set_##REG(POP()); \
+        unsigned char POP_ ## REG(Gameboy *gb) { \
+            set_##REG(&gb->cpu, POP(gb)); \
             return 12; \
         }
 
 // PUSH r16
 #define DEFINE_PUSH_r16(REG) \
-        unsigned char PUSH_ ## REG () { \
-            PUSH(REG()); \
+        unsigned char PUSH_ ## REG(Gameboy *gb) { \
+            PUSH(gb, REG(&gb->cpu)); \
             return 16; \
         }
 
@@ -957,61 +962,61 @@ DEFINE_STACK(AF)
 
 // INC r8
 #define DEFINE_INC_r8(REG) \
-        unsigned char INC_ ## REG () { \
-            cpu.REG = INC(cpu.REG); \
+        unsigned char INC_ ## REG(Gameboy *gb) { \
+            gb->cpu.REG = INC(&gb->cpu, gb->cpu.REG); \
             return 8; \
         }
 
 // DEC r8
 #define DEFINE_DEC_r8(REG) \
-        unsigned char DEC_ ## REG () { \
-            cpu.REG = DEC(cpu.REG); \
+        unsigned char DEC_ ## REG(Gameboy *gb) { \
+            gb->cpu.REG = DEC(&gb->cpu, gb->cpu.REG); \
             return 8; \
         }
 
 // LD r8,d8
 #define DEFINE_LD_r8_d8(REG) \
-        unsigned char LD_ ## REG ## _d8(unsigned char arg) { \
-            cpu.REG = arg; \
+        unsigned char LD_ ## REG ## _d8(Gameboy *gb, unsigned char arg) { \
+            gb->cpu.REG = arg; \
             return 8; \
         }
 
 // LD r8,r8
 #define DEFINE_LD_r8_r8(REG1, REG2) \
-        unsigned char LD_ ## REG1 ## _ ## REG2 () { \
-            cpu.REG1 = cpu.REG2; \
+        unsigned char LD_ ## REG1 ## _ ## REG2(Gameboy *gb) { \
+            gb->cpu.REG1 = gb->cpu.REG2; \
             return 4; \
         }
 
 // LD r8,(HL)
 #define DEFINE_LD_r8_HLp(REG) \
-        unsigned char LD_ ## REG ## _HLp () { \
-            cpu.REG = read_mmu(HL()); \
+        unsigned char LD_ ## REG ## _HLp(Gameboy *gb) { \
+            gb->cpu.REG = read_mmu(gb, HL(&gb->cpu)); \
             return 8; \
         }
 
 // LD (HL),r8
 #define DEFINE_LD_HLp_r8(REG) \
-        unsigned char LD_HLp_ ## REG () { \
-            write_mmu(HL(), cpu.REG); \
+        unsigned char LD_HLp_ ## REG(Gameboy *gb) { \
+            write_mmu(gb, HL(&gb->cpu), gb->cpu.REG); \
             return 8; \
         }
 
 #define DEFINE_OP_r8(OP, REG) \
-        unsigned char OP ## _ ## REG () { \
-            cpu.A = OP(cpu.A, cpu.REG); \
+        unsigned char OP ## _ ## REG(Gameboy *gb) { \
+            gb->cpu.A = OP(&gb->cpu, gb->cpu.A, gb->cpu.REG); \
             return 4; \
         }
 
 #define DEFINE_OP_d8(OP) \
-        unsigned char OP ## _d8 (unsigned char arg) { \
-            cpu.A = OP(cpu.A, arg); \
+        unsigned char OP ## _d8(Gameboy *gb, unsigned char arg) { \
+            gb->cpu.A = OP(&gb->cpu, gb->cpu.A, arg); \
             return 8; \
         }
 
 #define DEFINE_OP_HLp(OP) \
-        unsigned char OP ## _HLp () { \
-            cpu.A = OP(cpu.A, read_mmu(HL())); \
+        unsigned char OP ## _HLp(Gameboy *gb) { \
+            gb->cpu.A = OP(&gb->cpu, gb->cpu.A, read_mmu(gb, HL(&gb->cpu))); \
             return 8; \
         }
 
@@ -1059,8 +1064,8 @@ DEFINE_r8(L)
 DEFINE_r8(A)
 
 #define DEFINE_RST(VALUE) \
-        unsigned char RST_##VALUE() { \
-            RST(VALUE); \
+        unsigned char RST_##VALUE(Gameboy *gb) { \
+            RST(gb, VALUE); \
             return 16; \
         }
 
@@ -3,73 +3,75 @@
 #ifndef LIBCBOY_INSTRUCTIONS_H
 #define LIBCBOY_INSTRUCTIONS_H
 
-unsigned char NOP();
-unsigned char HALT();
-unsigned char JP(unsigned short addr);
-unsigned char JP_NZ_a16(unsigned short value);
-unsigned char JP_NC_a16(unsigned short value);
-unsigned char JP_C_a16(unsigned short value);
-unsigned char JP_Z_a16(unsigned short value);
-unsigned char JP_HL();
-unsigned char JR_C_r8(unsigned char value);
-unsigned char JR_NC_r8(unsigned char value);
-unsigned char JR_NZ_r8(unsigned char value);
-unsigned char JR_Z_r8(unsigned char value);
-unsigned char JR_r8(unsigned char value);
-unsigned char CALL_a16(unsigned short addr);
-unsigned char CALL_Z_a16(unsigned short addr);
-unsigned char CALL_NZ_a16(unsigned short addr);
-unsigned char CALL_NC_a16(unsigned short addr);
-unsigned char CALL_C_a16(unsigned short addr);
-unsigned char RET();
-unsigned char RET_C();
-unsigned char RET_NC();
-unsigned char RET_Z();
-unsigned char RET_NZ();
-unsigned char RETI();
-unsigned char ADD_SP_r8(char value);
-unsigned char RLCA();
-unsigned char RRCA();
-unsigned char RLA();
-unsigned char RRA();
-unsigned char DAA();
-unsigned char CPL();
-unsigned char SCF();
-unsigned char CCF();
-unsigned char LD_A_BC();
-unsigned char LD_BC_A();
-unsigned char LD_A_DE();
-unsigned char LD_DE_A();
-unsigned char LDI_HL_A();
-unsigned char LDI_A_HL();
-unsigned char LDD_HL_A();
-unsigned char LDD_A_HL();
-unsigned char LDH_n_A(unsigned char addr);
-unsigned char LDH_A_n(unsigned char addr);
-unsigned char LD_A_Cp();
-unsigned char LD_Cp_A();
-unsigned char LD_a16_SP(unsigned short addr);
-unsigned char LD_a16_A(unsigned short value);
-unsigned char LD_A_a16(unsigned short value);
-unsigned char LD_HL_SP_r8(char value);
-unsigned char LD_SP_HL();
-unsigned char DI();
-unsigned char EI();
-unsigned char INC_HLp();
-unsigned char DEC_HLp();
-unsigned char LD_HLp_d8();
+typedef struct Gameboy Gameboy;
+
+unsigned char NOP(Gameboy *gb);
+unsigned char HALT(Gameboy *gb);
+unsigned char JP(Gameboy *gb, unsigned short addr);
+unsigned char JP_NZ_a16(Gameboy *gb, unsigned short value);
+unsigned char JP_NC_a16(Gameboy *gb, unsigned short value);
+unsigned char JP_C_a16(Gameboy *gb, unsigned short value);
+unsigned char JP_Z_a16(Gameboy *gb, unsigned short value);
+unsigned char JP_HL(Gameboy *gb);
+unsigned char JR_C_r8(Gameboy *gb, unsigned char value);
+unsigned char JR_NC_r8(Gameboy *gb, unsigned char value);
+unsigned char JR_NZ_r8(Gameboy *gb, unsigned char value);
+unsigned char JR_Z_r8(Gameboy *gb, unsigned char value);
+unsigned char JR_r8(Gameboy *gb, unsigned char value);
+unsigned char CALL_a16(Gameboy *gb, unsigned short addr);
+unsigned char CALL_Z_a16(Gameboy *gb, unsigned short addr);
+unsigned char CALL_NZ_a16(Gameboy *gb, unsigned short addr);
+unsigned char CALL_NC_a16(Gameboy *gb, unsigned short addr);
+unsigned char CALL_C_a16(Gameboy *gb, unsigned short addr);
+unsigned char RET(Gameboy *gb);
+unsigned char RET_C(Gameboy *gb);
+unsigned char RET_NC(Gameboy *gb);
+unsigned char RET_Z(Gameboy *gb);
+unsigned char RET_NZ(Gameboy *gb);
+unsigned char RETI(Gameboy *gb);
+unsigned char ADD_SP_r8(Gameboy *gb, unsigned char value);
+unsigned char RLCA(Gameboy *gb);
+unsigned char RRCA(Gameboy *gb);
+unsigned char RLA(Gameboy *gb);
+unsigned char RRA(Gameboy *gb);
+unsigned char DAA(Gameboy *gb);
+unsigned char CPL(Gameboy *gb);
+unsigned char SCF(Gameboy *gb);
+unsigned char CCF(Gameboy *gb);
+unsigned char LD_A_BC(Gameboy *gb);
+unsigned char LD_BC_A(Gameboy *gb);
+unsigned char LD_A_DE(Gameboy *gb);
+unsigned char LD_DE_A(Gameboy *gb);
+unsigned char LDI_HL_A(Gameboy *gb);
+unsigned char LDI_A_HL(Gameboy *gb);
+unsigned char LDD_HL_A(Gameboy *gb);
+unsigned char LDD_A_HL(Gameboy *gb);
+unsigned char LDH_n_A(Gameboy *gb, unsigned char addr);
+unsigned char LDH_A_n(Gameboy *gb, unsigned char addr);
+unsigned char LD_A_Cp(Gameboy *gb);
+unsigned char LD_Cp_A(Gameboy *gb);
+unsigned char LD_a16_SP(Gameboy *gb, unsigned short addr);
+unsigned char LD_a16_A(Gameboy *gb, unsigned short value);
+unsigned char LD_A_a16(Gameboy *gb, unsigned short value);
+unsigned char LD_HL_SP_r8(Gameboy *gb, unsigned char value);
+unsigned char LD_SP_HL(Gameboy *gb);
+unsigned char DI(Gameboy *gb);
+unsigned char EI(Gameboy *gb);
+unsigned char INC_HLp(Gameboy *gb);
+unsigned char DEC_HLp(Gameboy *gb);
+unsigned char LD_HLp_d8(Gameboy *gb, unsigned char arg);
 
 #define DEFINE_OP_REG(OP, REG) \
-        unsigned char OP ## _ ## REG();
+        unsigned char OP ## _ ## REG(Gameboy *gb);
 
 #define DEFINE_OP_REG1_REG2(OP, REG1, REG2) \
-        unsigned char OP ## _ ## REG1 ## _ ## REG2();
+        unsigned char OP ## _ ## REG1 ## _ ## REG2(Gameboy *gb);
 
 #define DEFINE_r16(REG) \
         DEFINE_OP_REG(INC, REG) \
         DEFINE_OP_REG(DEC, REG) \
         DEFINE_OP_REG1_REG2(ADD, HL, REG) \
-        DEFINE_OP_REG1_REG2(LD, REG, d16)
+        unsigned char LD_ ## REG ## _d16(Gameboy *gb, unsigned short arg);
 
 DEFINE_r16(BC)
 DEFINE_r16(DE)
@@ -88,7 +90,7 @@ DEFINE_STACK(AF)
 #define DEFINE_r8(REG) \
         DEFINE_OP_REG(INC, REG) \
         DEFINE_OP_REG(DEC, REG) \
-        DEFINE_OP_REG1_REG2(LD, REG, d8) \
+        unsigned char LD_ ## REG ## _d8(Gameboy *gb, unsigned char arg); \
         DEFINE_OP_REG1_REG2(LD, REG, B) \
         DEFINE_OP_REG1_REG2(LD, REG, C) \
         DEFINE_OP_REG1_REG2(LD, REG, D) \
@@ -117,7 +119,7 @@ DEFINE_r8(A)
 
 #define DEFINE_OP(OP) \
         DEFINE_OP_REG(OP, HLp) \
-        DEFINE_OP_REG(OP, d8)
+        unsigned char OP ## _d8(Gameboy *gb, unsigned char arg);
 
 DEFINE_OP(ADD)
 DEFINE_OP(ADC)
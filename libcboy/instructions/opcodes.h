@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIBCBOY_OPCODES_H
+#define LIBCBOY_OPCODES_H
+
+/*
+ * Opcode tables as X-macros, so that every interpreter core is generated from the same list.
+ *
+ * OPCODES expands one entry per opcode, depending on the number of immediate bytes that follow it:
+ *   X(opcode, handler)      no operand
+ *   X_d8(opcode, handler)   one byte operand
+ *   X_d16(opcode, handler)  two byte operand (LS byte first)
+ *   X_ILLEGAL(opcode)       unused opcode, skips two bytes and behaves like NOP
+ *   X_PREFIX(opcode)        0xCB, the actual opcode follows in CB_OPCODES
+ */
+#define OPCODES(X, X_d8, X_d16, X_ILLEGAL, X_PREFIX) \
+X(0x00, NOP) X_d16(0x01, LD_BC_d16) X(0x02, LD_BC_A) X(0x03, INC_BC) X(0x04, INC_B) X(0x05, DEC_B) X_d8(0x06, LD_B_d8) X(0x07, RLCA) \
+    X_d16(0x08, LD_a16_SP) X(0x09, ADD_HL_BC) X(0x0A, LD_A_BC) X(0x0B, DEC_BC) X(0x0C, INC_C) X(0x0D, DEC_C) X_d8(0x0E, LD_C_d8) X(0x0F, RRCA) \
+    X(0x10, NOP) X_d16(0x11, LD_DE_d16) X(0x12, LD_DE_A) X(0x13, INC_DE) X(0x14, INC_D) X(0x15, DEC_D) X_d8(0x16, LD_D_d8) X(0x17, RLA) \
+    X_d8(0x18, JR_r8) X(0x19, ADD_HL_DE) X(0x1A, LD_A_DE) X(0x1B, DEC_DE) X(0x1C, INC_E) X(0x1D, DEC_E) X_d8(0x1E, LD_E_d8) X(0x1F, RRA) \
+    X_d8(0x20, JR_NZ_r8) X_d16(0x21, LD_HL_d16) X(0x22, LDI_HL_A) X(0x23, INC_HL) X(0x24, INC_H) X(0x25, DEC_H) X_d8(0x26, LD_H_d8) X(0x27, DAA) \
+    X_d8(0x28, JR_Z_r8) X(0x29, ADD_HL_HL) X(0x2A, LDI_A_HL) X(0x2B, DEC_HL) X(0x2C, INC_L) X(0x2D, DEC_L) X_d8(0x2E, LD_L_d8) X(0x2F, CPL) \
+    X_d8(0x30, JR_NC_r8) X_d16(0x31, LD_SP_d16) X(0x32, LDD_HL_A) X(0x33, INC_SP) X(0x34, INC_HLp) X(0x35, DEC_HLp) X_d8(0x36, LD_HLp_d8) X(0x37, SCF) \
+    X_d8(0x38, JR_C_r8) X(0x39, ADD_HL_SP) X(0x3A, LDD_A_HL) X(0x3B, DEC_SP) X(0x3C, INC_A) X(0x3D, DEC_A) X_d8(0x3E, LD_A_d8) X(0x3F, CCF) \
+    X(0x40, LD_B_B) X(0x41, LD_B_C) X(0x42, LD_B_D) X(0x43, LD_B_E) X(0x44, LD_B_H) X(0x45, LD_B_L) X(0x46, LD_B_HLp) X(0x47, LD_B_A) \
+    X(0x48, LD_C_B) X(0x49, LD_C_C) X(0x4A, LD_C_D) X(0x4B, LD_C_E) X(0x4C, LD_C_H) X(0x4D, LD_C_L) X(0x4E, LD_C_HLp) X(0x4F, LD_C_A) \
+    X(0x50, LD_D_B) X(0x51, LD_D_C) X(0x52, LD_D_D) X(0x53, LD_D_E) X(0x54, LD_D_H) X(0x55, LD_D_L) X(0x56, LD_D_HLp) X(0x57, LD_D_A) \
+    X(0x58, LD_E_B) X(0x59, LD_E_C) X(0x5A, LD_E_D) X(0x5B, LD_E_E) X(0x5C, LD_E_H) X(0x5D, LD_E_L) X(0x5E, LD_E_HLp) X(0x5F, LD_E_A) \
+    X(0x60, LD_H_B) X(0x61, LD_H_C) X(0x62, LD_H_D) X(0x63, LD_H_E) X(0x64, LD_H_H) X(0x65, LD_H_L) X(0x66, LD_H_HLp) X(0x67, LD_H_A) \
+    X(0x68, LD_L_B) X(0x69, LD_L_C) X(0x6A, LD_L_D) X(0x6B, LD_L_E) X(0x6C, LD_L_H) X(0x6D, LD_L_L) X(0x6E, LD_L_HLp) X(0x6F, LD_L_A) \
+    X(0x70, LD_HLp_B) X(0x71, LD_HLp_C) X(0x72, LD_HLp_D) X(0x73, LD_HLp_E) X(0x74, LD_HLp_H) X(0x75, LD_HLp_L) X(0x76, HALT) X(0x77, LD_HLp_A) \
+    X(0x78, LD_A_B) X(0x79, LD_A_C) X(0x7A, LD_A_D) X(0x7B, LD_A_E) X(0x7C, LD_A_H) X(0x7D, LD_A_L) X(0x7E, LD_A_HLp) X(0x7F, LD_A_A) \
+    X(0x80, ADD_B) X(0x81, ADD_C) X(0x82, ADD_D) X(0x83, ADD_E) X(0x84, ADD_H) X(0x85, ADD_L) X(0x86, ADD_HLp) X(0x87, ADD_A) \
+    X(0x88, ADC_B) X(0x89, ADC_C) X(0x8A, ADC_D) X(0x8B, ADC_E) X(0x8C, ADC_H) X(0x8D, ADC_L) X(0x8E, ADC_HLp) X(0x8F, ADC_A) \
+    X(0x90, SUB_B) X(0x91, SUB_C) X(0x92, SUB_D) X(0x93, SUB_E) X(0x94, SUB_H) X(0x95, SUB_L) X(0x96, SUB_HLp) X(0x97, SUB_A) \
+    X(0x98, SBC_B) X(0x99, SBC_C) X(0x9A, SBC_D) X(0x9B, SBC_E) X(0x9C, SBC_H) X(0x9D, SBC_L) X(0x9E, SBC_HLp) X(0x9F, SBC_A) \
+    X(0xA0, AND_B) X(0xA1, AND_C) X(0xA2, AND_D) X(0xA3, AND_E) X(0xA4, AND_H) X(0xA5, AND_L) X(0xA6, AND_HLp) X(0xA7, AND_A) \
+    X(0xA8, XOR_B) X(0xA9, XOR_C) X(0xAA, XOR_D) X(0xAB, XOR_E) X(0xAC, XOR_H) X(0xAD, XOR_L) X(0xAE, XOR_HLp) X(0xAF, XOR_A) \
+    X(0xB0, OR_B) X(0xB1, OR_C) X(0xB2, OR_D) X(0xB3, OR_E) X(0xB4, OR_H) X(0xB5, OR_L) X(0xB6, OR_HLp) X(0xB7, OR_A) \
+    X(0xB8, CP_B) X(0xB9, CP_C) X(0xBA, CP_D) X(0xBB, CP_E) X(0xBC, CP_H) X(0xBD, CP_L) X(0xBE, CP_HLp) X(0xBF, CP_A) \
+    X(0xC0, RET_NZ) X(0xC1, POP_BC) X_d16(0xC2, JP_NZ_a16) X_d16(0xC3, JP) X_d16(0xC4, CALL_NZ_a16) X(0xC5, PUSH_BC) X_d8(0xC6, ADD_d8) X(0xC7, RST_0x0) \
+    X(0xC8, RET_Z) X(0xC9, RET) X_d16(0xCA, JP_Z_a16) X_PREFIX(0xCB) X_d16(0xCC, CALL_Z_a16) X_d16(0xCD, CALL_a16) X_d8(0xCE, ADC_d8) X(0xCF, RST_0x8) \
+    X(0xD0, RET_NC) X(0xD1, POP_DE) X_d16(0xD2, JP_NC_a16) X_ILLEGAL(0xD3) X_d16(0xD4, CALL_NC_a16) X(0xD5, PUSH_DE) X_d8(0xD6, SUB_d8) X(0xD7, RST_0x10) \
+    X(0xD8, RET_C) X(0xD9, RETI) X_d16(0xDA, JP_C_a16) X_ILLEGAL(0xDB) X_d16(0xDC, CALL_C_a16) X_ILLEGAL(0xDD) X_d8(0xDE, SBC_d8) X(0xDF, RST_0x18) \
+    X_d8(0xE0, LDH_n_A) X(0xE1, POP_HL) X(0xE2, LD_Cp_A) X_ILLEGAL(0xE3) X_ILLEGAL(0xE4) X(0xE5, PUSH_HL) X_d8(0xE6, AND_d8) X(0xE7, RST_0x20) \
+    X_d8(0xE8, ADD_SP_r8) X(0xE9, JP_HL) X_d16(0xEA, LD_a16_A) X_ILLEGAL(0xEB) X_ILLEGAL(0xEC) X_ILLEGAL(0xED) X_d8(0xEE, XOR_d8) X(0xEF, RST_0x28) \
+    X_d8(0xF0, LDH_A_n) X(0xF1, POP_AF) X(0xF2, LD_A_Cp) X(0xF3, DI) X_ILLEGAL(0xF4) X(0xF5, PUSH_AF) X_d8(0xF6, OR_d8) X(0xF7, RST_0x30) \
+    X_d8(0xF8, LD_HL_SP_r8) X(0xF9, LD_SP_HL) X_d16(0xFA, LD_A_a16) X(0xFB, EI) X_ILLEGAL(0xFC) X_ILLEGAL(0xFD) X_d8(0xFE, CP_d8) X(0xFF, RST_0x38)
+
+/*
+ * CB prefixed opcodes, all of them take 8 cycles and have no operand.
+ */
+#define CB_OPCODES(X) \
+    X(0x00, RLC_B) X(0x01, RLC_C) X(0x02, RLC_D) X(0x03, RLC_E) X(0x04, RLC_H) X(0x05, RLC_L) X(0x06, RLC_HL) X(0x07, RLC_A) \
+    X(0x08, RRC_B) X(0x09, RRC_C) X(0x0A, RRC_D) X(0x0B, RRC_E) X(0x0C, RRC_H) X(0x0D, RRC_L) X(0x0E, RRC_HL) X(0x0F, RRC_A) \
+    X(0x10, RL_B) X(0x11, RL_C) X(0x12, RL_D) X(0x13, RL_E) X(0x14, RL_H) X(0x15, RL_L) X(0x16, RL_HL) X(0x17, RL_A) \
+    X(0x18, RR_B) X(0x19, RR_C) X(0x1A, RR_D) X(0x1B, RR_E) X(0x1C, RR_H) X(0x1D, RR_L) X(0x1E, RR_HL) X(0x1F, RR_A) \
+    X(0x20, SLA_B) X(0x21, SLA_C) X(0x22, SLA_D) X(0x23, SLA_E) X(0x24, SLA_H) X(0x25, SLA_L) X(0x26, SLA_HL) X(0x27, SLA_A) \
+    X(0x28, SRA_B) X(0x29, SRA_C) X(0x2A, SRA_D) X(0x2B, SRA_E) X(0x2C, SRA_H) X(0x2D, SRA_L) X(0x2E, SRA_HL) X(0x2F, SRA_A) \
+    X(0x30, SWAP_B) X(0x31, SWAP_C) X(0x32, SWAP_D) X(0x33, SWAP_E) X(0x34, SWAP_H) X(0x35, SWAP_L) X(0x36, SWAP_HL) X(0x37, SWAP_A) \
+    X(0x38, SRL_B) X(0x39, SRL_C) X(0x3A, SRL_D) X(0x3B, SRL_E) X(0x3C, SRL_H) X(0x3D, SRL_L) X(0x3E, SRL_HL) X(0x3F, SRL_A) \
+    X(0x40, BIT_0_B) X(0x41, BIT_0_C) X(0x42, BIT_0_D) X(0x43, BIT_0_E) X(0x44, BIT_0_H) X(0x45, BIT_0_L) X(0x46, BIT_0_HL) X(0x47, BIT_0_A) \
+    X(0x48, BIT_1_B) X(0x49, BIT_1_C) X(0x4A, BIT_1_D) X(0x4B, BIT_1_E) X(0x4C, BIT_1_H) X(0x4D, BIT_1_L) X(0x4E, BIT_1_HL) X(0x4F, BIT_1_A) \
+    X(0x50, BIT_2_B) X(0x51, BIT_2_C) X(0x52, BIT_2_D) X(0x53, BIT_2_E) X(0x54, BIT_2_H) X(0x55, BIT_2_L) X(0x56, BIT_2_HL) X(0x57, BIT_2_A) \
+    X(0x58, BIT_3_B) X(0x59, BIT_3_C) X(0x5A, BIT_3_D) X(0x5B, BIT_3_E) X(0x5C, BIT_3_H) X(0x5D, BIT_3_L) X(0x5E, BIT_3_HL) X(0x5F, BIT_3_A) \
+    X(0x60, BIT_4_B) X(0x61, BIT_4_C) X(0x62, BIT_4_D) X(0x63, BIT_4_E) X(0x64, BIT_4_H) X(0x65, BIT_4_L) X(0x66, BIT_4_HL) X(0x67, BIT_4_A) \
+    X(0x68, BIT_5_B) X(0x69, BIT_5_C) X(0x6A, BIT_5_D) X(0x6B, BIT_5_E) X(0x6C, BIT_5_H) X(0x6D, BIT_5_L) X(0x6E, BIT_5_HL) X(0x6F, BIT_5_A) \
+    X(0x70, BIT_6_B) X(0x71, BIT_6_C) X(0x72, BIT_6_D) X(0x73, BIT_6_E) X(0x74, BIT_6_H) X(0x75, BIT_6_L) X(0x76, BIT_6_HL) X(0x77, BIT_6_A) \
+    X(0x78, BIT_7_B) X(0x79, BIT_7_C) X(0x7A, BIT_7_D) X(0x7B, BIT_7_E) X(0x7C, BIT_7_H) X(0x7D, BIT_7_L) X(0x7E, BIT_7_HL) X(0x7F, BIT_7_A) \
+    X(0x80, RES_0_B) X(0x81, RES_0_C) X(0x82, RES_0_D) X(0x83, RES_0_E) X(0x84, RES_0_H) X(0x85, RES_0_L) X(0x86, RES_0_HL) X(0x87, RES_0_A) \
+    X(0x88, RES_1_B) X(0x89, RES_1_C) X(0x8A, RES_1_D) X(0x8B, RES_1_E) X(0x8C, RES_1_H) X(0x8D, RES_1_L) X(0x8E, RES_1_HL) X(0x8F, RES_1_A) \
+    X(0x90, RES_2_B) X(0x91, RES_2_C) X(0x92, RES_2_D) X(0x93, RES_2_E) X(0x94, RES_2_H) X(0x95, RES_2_L) X(0x96, RES_2_HL) X(0x97, RES_2_A) \
+    X(0x98, RES_3_B) X(0x99, RES_3_C) X(0x9A, RES_3_D) X(0x9B, RES_3_E) X(0x9C, RES_3_H) X(0x9D, RES_3_L) X(0x9E, RES_3_HL) X(0x9F, RES_3_A) \
+    X(0xA0, RES_4_B) X(0xA1, RES_4_C) X(0xA2, RES_4_D) X(0xA3, RES_4_E) X(0xA4, RES_4_H) X(0xA5, RES_4_L) X(0xA6, RES_4_HL) X(0xA7, RES_4_A) \
+    X(0xA8, RES_5_B) X(0xA9, RES_5_C) X(0xAA, RES_5_D) X(0xAB, RES_5_E) X(0xAC, RES_5_H) X(0xAD, RES_5_L) X(0xAE, RES_5_HL) X(0xAF, RES_5_A) \
+    X(0xB0, RES_6_B) X(0xB1, RES_6_C) X(0xB2, RES_6_D) X(0xB3, RES_6_E) X(0xB4, RES_6_H) X(0xB5, RES_6_L) X(0xB6, RES_6_HL) X(0xB7, RES_6_A) \
+    X(0xB8, RES_7_B) X(0xB9, RES_7_C) X(0xBA, RES_7_D) X(0xBB, RES_7_E) X(0xBC, RES_7_H) X(0xBD, RES_7_L) X(0xBE, RES_7_HL) X(0xBF, RES_7_A) \
+    X(0xC0, SET_0_B) X(0xC1, SET_0_C) X(0xC2, SET_0_D) X(0xC3, SET_0_E) X(0xC4, SET_0_H) X(0xC5, SET_0_L) X(0xC6, SET_0_HL) X(0xC7, SET_0_A) \
+    X(0xC8, SET_1_B) X(0xC9, SET_1_C) X(0xCA, SET_1_D) X(0xCB, SET_1_E) X(0xCC, SET_1_H) X(0xCD, SET_1_L) X(0xCE, SET_1_HL) X(0xCF, SET_1_A) \
+    X(0xD0, SET_2_B) X(0xD1, SET_2_C) X(0xD2, SET_2_D) X(0xD3, SET_2_E) X(0xD4, SET_2_H) X(0xD5, SET_2_L) X(0xD6, SET_2_HL) X(0xD7, SET_2_A) \
+    X(0xD8, SET_3_B) X(0xD9, SET_3_C) X(0xDA, SET_3_D) X(0xDB, SET_3_E) X(0xDC, SET_3_H) X(0xDD, SET_3_L) X(0xDE, SET_3_HL) X(0xDF, SET_3_A) \
+    X(0xE0, SET_4_B) X(0xE1, SET_4_C) X(0xE2, SET_4_D) X(0xE3, SET_4_E) X(0xE4, SET_4_H) X(0xE5, SET_4_L) X(0xE6, SET_4_HL) X(0xE7, SET_4_A) \
+    X(0xE8, SET_5_B) X(0xE9, SET_5_C) X(0xEA, SET_5_D) X(0xEB, SET_5_E) X(0xEC, SET_5_H) X(0xED, SET_5_L) X(0xEE, SET_5_HL) X(0xEF, SET_5_A) \
+    X(0xF0, SET_6_B) X(0xF1, SET_6_C) X(0xF2, SET_6_D) X(0xF3, SET_6_E) X(0xF4, SET_6_H) X(0xF5, SET_6_L) X(0xF6, SET_6_HL) X(0xF7, SET_6_A) \
+    X(0xF8, SET_7_B) X(0xF9, SET_7_C) X(0xFA, SET_7_D) X(0xFB, SET_7_E) X(0xFC, SET_7_H) X(0xFD, SET_7_L) X(0xFE, SET_7_HL) X(0xFF, SET_7_A)
+
+#endif // LIBCBOY_OPCODES_H
\ No newline at end of file
@@ -0,0 +1,912 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifdef JIT
+
+#include <stddef.h>
+#include <string.h>
+
+#include "gameboy.h"
+#include "jit.h"
+
+#ifdef JIT_CHECK
+#include <stdlib.h>
+
+// the copy of the instance that run_checked in cpu.c compares compiled blocks against
+static void free_shadow(Gameboy *gb) {
+    if (gb->jit.shadow != NULL)
+        free(gb->jit.shadow->mmu.mbc.ram);
+    free(gb->jit.shadow);
+    gb->jit.shadow = NULL;
+}
+#endif
+
+#if defined(__x86_64__) && !defined(_WIN32)
+
+#include <sys/mman.h>
+
+/*
+ * x86-64 backend, System V calling convention.
+ *
+ * A compiled block is the unrolled loop of run_block: for every instruction it runs the instruction, advances
+ * the cycle counter of the scheduler and checks the same exit conditions. A, HL, the Z and C flags and the
+ * cycle counter stay in callee saved registers for the whole block and are only written back to the Cpu
+ * struct when the block is left or a handler is called. Loads, ALU operations, INC/DEC, 16 bit loads and
+ * increments, most CB operations and the jumps that end a block are emitted inline, memory accesses look
+ * up the page in the memory map and only call read_mmu or write_mmu for pages without host memory. The
+ * other instructions call their handler. A block that jumps back to its own start keeps looping natively
+ * for as long as next_instructions would run it again.
+ *
+ *   rbx  Gameboy *gb
+ *   rbp  scheduler.now
+ *   r12d A
+ *   r13d HL
+ *   r14d z_result
+ *   r15d c_flag
+ */
+
+#define OFFSET(FIELD) ((unsigned int)offsetof(Gameboy, FIELD))
+
+_Static_assert(offsetof(Cpu, L) == offsetof(Cpu, H) + 1 && offsetof(Cpu, C) == offsetof(Cpu, B) + 1 &&
+                   offsetof(Cpu, E) == offsetof(Cpu, D) + 1,
+               "register pairs are loaded as one word");
+
+// Cpu register by the 3 bit operand encoding of the opcode, (HL) is 6
+static const unsigned int registers[8] = {
+    OFFSET(cpu.B), OFFSET(cpu.C), OFFSET(cpu.D), OFFSET(cpu.E), OFFSET(cpu.H), OFFSET(cpu.L), 0, OFFSET(cpu.A),
+};
+
+// host registers for values in flight
+enum { EAX, ECX, EDX };
+
+typedef struct {
+    unsigned char *code;
+    unsigned char *start; // of the first instruction, blocks that loop jump back to it
+    struct {
+        unsigned char *site; // rel32 of a jump out of the block
+        int pc;              // stored before leaving, -1 if it is already set
+    } exits[BLOCK_LENGTH * 4];
+    unsigned char count;
+} Emitter;
+
+static void emit(Emitter *e, const unsigned char *bytes, size_t length) {
+    memcpy(e->code, bytes, length);
+    e->code += length;
+}
+
+#define EMIT(...) emit(e, (const unsigned char[]){__VA_ARGS__}, sizeof((const unsigned char[]){__VA_ARGS__}))
+
+static void emit16(Emitter *e, unsigned short value) {
+    memcpy(e->code, &value, 2);
+    e->code += 2;
+}
+
+static void emit32(Emitter *e, unsigned int value) {
+    memcpy(e->code, &value, 4);
+    e->code += 4;
+}
+
+static void emit64(Emitter *e, unsigned long long value) {
+    memcpy(e->code, &value, 8);
+    e->code += 8;
+}
+
+// Jcc/JMP rel32 out of the block, patched once the block is complete
+static void emit_exit(Emitter *e, int pc) {
+    e->exits[e->count].site = e->code;
+    e->exits[e->count++].pc = pc;
+    emit32(e, 0);
+}
+
+// Jcc rel8 over code that is emitted next, patched by land
+static unsigned char *skip(Emitter *e) {
+    EMIT(0x00);
+    return e->code;
+}
+
+static void land(Emitter *e, unsigned char *from) { from[-1] = e->code - from; }
+
+// mov rax, function; call rax
+static void emit_call(Emitter *e, void *function) {
+    EMIT(0x48, 0xB8);
+    emit64(e, (unsigned long long)function);
+    EMIT(0xFF, 0xD0);
+}
+
+// mov byte [rbx + offset], value
+static void store_byte(Emitter *e, unsigned int offset, unsigned char value) {
+    EMIT(0xC6, 0x83);
+    emit32(e, offset);
+    EMIT(value);
+}
+
+// the N flag and how H is evaluated, for operations that leave the operands of H alone
+static void store_nh(Emitter *e, bool n, unsigned char h_op) {
+    store_byte(e, OFFSET(cpu.n_flag), n);
+    store_byte(e, OFFSET(cpu.h_op), h_op);
+}
+
+// everything set_half_carry and set_flag_N store, the first operand in the word register a (REX prefix in rex)
+static void store_half_carry(Emitter *e, unsigned char rex, unsigned char a, unsigned char op, bool n) {
+    // mov [rbx + h_a], a
+    if (rex)
+        EMIT(0x66, rex, 0x89, 0x83 | a << 3);
+    else
+        EMIT(0x66, 0x89, 0x83 | a << 3);
+    emit32(e, OFFSET(cpu.h_a));
+    store_byte(e, OFFSET(cpu.h_op), op);
+    store_byte(e, OFFSET(cpu.n_flag), n);
+}
+
+// writes the guest state kept in host registers back to the Cpu struct and the scheduler
+static void store_state(Emitter *e) {
+    // mov [rbx + now], rbp; mov [rbx + A], r12b
+    EMIT(0x48, 0x89, 0xAB);
+    emit32(e, OFFSET(scheduler.now));
+    EMIT(0x44, 0x88, 0xA3);
+    emit32(e, OFFSET(cpu.A));
+    // mov eax, r13d; rol ax, 8; mov [rbx + H], ax
+    EMIT(0x44, 0x89, 0xE8, 0x66, 0xC1, 0xC0, 0x08, 0x66, 0x89, 0x83);
+    emit32(e, OFFSET(cpu.H));
+    // mov [rbx + z_result], r14b; mov [rbx + c_flag], r15b
+    EMIT(0x44, 0x88, 0xB3);
+    emit32(e, OFFSET(cpu.z_result));
+    EMIT(0x44, 0x88, 0xBB);
+    emit32(e, OFFSET(cpu.c_flag));
+}
+
+// the registers store_state writes, without the cycle counter
+static void load_registers(Emitter *e) {
+    // movzx r12d, byte [rbx + A]
+    EMIT(0x44, 0x0F, 0xB6, 0xA3);
+    emit32(e, OFFSET(cpu.A));
+    // movzx r13d, word [rbx + H]; rol r13w, 8
+    EMIT(0x44, 0x0F, 0xB7, 0xAB);
+    emit32(e, OFFSET(cpu.H));
+    EMIT(0x66, 0x41, 0xC1, 0xC5, 0x08);
+    // movzx r14d, byte [rbx + z_result]; movzx r15d, byte [rbx + c_flag]
+    EMIT(0x44, 0x0F, 0xB6, 0xB3);
+    emit32(e, OFFSET(cpu.z_result));
+    EMIT(0x44, 0x0F, 0xB6, 0xBB);
+    emit32(e, OFFSET(cpu.c_flag));
+}
+
+// zero extends the guest register r (not 6) into host
+static void load_register(Emitter *e, unsigned char r, unsigned char host) {
+    switch (r) {
+    case 4:
+        // mov host, r13d; shr host, 8
+        EMIT(0x44, 0x89, 0xE8 | host, 0xC1, 0xE8 | host, 0x08);
+        break;
+    case 5:
+        // movzx host, r13b
+        EMIT(0x41, 0x0F, 0xB6, 0xC5 | host << 3);
+        break;
+    case 7:
+        // mov host, r12d
+        EMIT(0x44, 0x89, 0xE0 | host);
+        break;
+    default:
+        // movzx host, byte [rbx + r]
+        EMIT(0x0F, 0xB6, 0x83 | host << 3);
+        emit32(e, registers[r]);
+    }
+}
+
+// stores the low byte of host to the guest register r (not 6)
+static void store_register(Emitter *e, unsigned char r, unsigned char host) {
+    switch (r) {
+    case 4:
+        // and r13d, 0xFF; movzx host, host8; shl host, 8; or r13d, host
+        EMIT(0x41, 0x81, 0xE5, 0xFF, 0x00, 0x00, 0x00, 0x0F, 0xB6, 0xC0 | host << 3 | host, 0xC1, 0xE0 | host, 0x08);
+        EMIT(0x41, 0x09, 0xC5 | host << 3);
+        break;
+    case 5:
+        // mov r13b, host8
+        EMIT(0x41, 0x88, 0xC5 | host << 3);
+        break;
+    case 7:
+        // movzx r12d, host8
+        EMIT(0x44, 0x0F, 0xB6, 0xE0 | host);
+        break;
+    default:
+        // mov [rbx + r], host8
+        EMIT(0x88, 0x83 | host << 3);
+        emit32(e, registers[r]);
+    }
+}
+
+// movzx ecx, word [rbx + pair]; rol cx, 8, for BC and DE
+static void load_pair(Emitter *e, unsigned int offset) {
+    EMIT(0x0F, 0xB7, 0x8B);
+    emit32(e, offset);
+    EMIT(0x66, 0xC1, 0xC1, 0x08);
+}
+
+// eax = read_mmu(gb, ecx), inline for the pages in the memory map
+static void emit_read(Emitter *e) {
+    // movzx edx, ch; mov rax, [rbx + rdx * 8 + read]; test rax, rax; jz slow
+    EMIT(0x0F, 0xB6, 0xD5, 0x48, 0x8B, 0x84, 0xD3);
+    emit32(e, OFFSET(map.read));
+    EMIT(0x48, 0x85, 0xC0, 0x74);
+    unsigned char *slow = skip(e);
+
+    // movzx ecx, cl; movzx eax, byte [rax + rcx]; jmp done
+    EMIT(0x0F, 0xB6, 0xC9, 0x0F, 0xB6, 0x04, 0x08, 0xEB);
+    unsigned char *done = skip(e);
+
+    // IO handlers see the cycle counter of the start of the instruction
+    land(e, slow);
+    EMIT(0x48, 0x89, 0xAB);
+    emit32(e, OFFSET(scheduler.now));
+    // mov rdi, rbx; mov esi, ecx; call read_mmu; movzx eax, al
+    EMIT(0x48, 0x89, 0xDF, 0x89, 0xCE);
+    emit_call(e, (void *)read_mmu);
+    EMIT(0x0F, 0xB6, 0xC0);
+    land(e, done);
+}
+
+// write_mmu(gb, ecx, al), inline for the pages in the memory map
+static void emit_write(Emitter *e) {
+    // movzx edx, ch; mov rdx, [rbx + rdx * 8 + write]; test rdx, rdx; jz slow
+    EMIT(0x0F, 0xB6, 0xD5, 0x48, 0x8B, 0x94, 0xD3);
+    emit32(e, OFFSET(map.write));
+    EMIT(0x48, 0x85, 0xD2, 0x74);
+    unsigned char *slow = skip(e);
+
+    // movzx ecx, cl; mov [rdx + rcx], al; jmp done
+    EMIT(0x0F, 0xB6, 0xC9, 0x88, 0x04, 0x0A, 0xEB);
+    unsigned char *done = skip(e);
+
+    land(e, slow);
+    EMIT(0x48, 0x89, 0xAB);
+    emit32(e, OFFSET(scheduler.now));
+    // mov rdi, rbx; mov esi, ecx; movzx edx, al; call write_mmu
+    EMIT(0x48, 0x89, 0xDF, 0x89, 0xCE, 0x0F, 0xB6, 0xD0);
+    emit_call(e, (void *)write_mmu);
+    land(e, done);
+}
+
+// mov ecx, r13d
+static void address_hl(Emitter *e) { EMIT(0x44, 0x89, 0xE9); }
+
+// inc r13w or dec r13w
+static void step_hl(Emitter *e, bool down) { EMIT(0x66, 0x41, 0xFF, down ? 0xCD : 0xC5); }
+
+// the operand of an ALU or INC/DEC instruction into host, r is the 3 bit operand encoding
+static void load_operand(Emitter *e, unsigned char r, unsigned char host) {
+    if (r == 6) {
+        address_hl(e);
+        emit_read(e);
+        if (host != EAX)
+            EMIT(0x89, 0xC0 | host); // mov host, eax
+    } else {
+        load_register(e, r, host);
+    }
+}
+
+// ADD, ADC, SUB, SBC, AND, XOR, OR or CP of A and ecx, by bits 3-5 of the opcode
+static void emit_alu(Emitter *e, unsigned char op) {
+    if (op >= 4 && op <= 6) {
+        // and/xor/or r12d, ecx; mov r14d, r12d; xor r15d, r15d
+        static const unsigned char opcodes[] = {0x21, 0x31, 0x09};
+        EMIT(0x41, opcodes[op - 4], 0xCC, 0x45, 0x89, 0xE6, 0x45, 0x31, 0xFF);
+        store_nh(e, false, op == 4 ? HALF_SET : HALF_CLEAR);
+        return;
+    }
+
+    bool sub = op >= 2;
+    store_half_carry(e, 0x44, 4, sub ? HALF_SUB : HALF_ADD, sub);
+    // mov [rbx + h_b], cx
+    EMIT(0x66, 0x89, 0x8B);
+    emit32(e, OFFSET(cpu.h_b));
+
+    if (op == 1 || op == 3) {
+        // mov [rbx + h_carry], r15b; add ecx, r15d
+        EMIT(0x44, 0x88, 0xBB);
+        emit32(e, OFFSET(cpu.h_carry));
+        EMIT(0x44, 0x01, 0xF9);
+    } else {
+        store_byte(e, OFFSET(cpu.h_carry), 0);
+    }
+
+    if (op == 7) {
+        // mov eax, r12d; sub eax, ecx; setb r15b; movzx r14d, al
+        EMIT(0x44, 0x89, 0xE0, 0x29, 0xC8, 0x41, 0x0F, 0x92, 0xC7, 0x44, 0x0F, 0xB6, 0xF0);
+        return;
+    }
+
+    if (sub) {
+        // sub r12d, ecx; setb r15b
+        EMIT(0x41, 0x29, 0xCC, 0x41, 0x0F, 0x92, 0xC7);
+    } else {
+        // add r12d, ecx; cmp r12d, 0xFF; seta r15b
+        EMIT(0x41, 0x01, 0xCC, 0x41, 0x81, 0xFC, 0xFF, 0x00, 0x00, 0x00, 0x41, 0x0F, 0x97, 0xC7);
+    }
+    // movzx r12d, r12b; mov r14d, r12d
+    EMIT(0x45, 0x0F, 0xB6, 0xE4, 0x45, 0x89, 0xE6);
+}
+
+// rotates and shifts of eax by bits 3-5 of the CB opcode, result in eax, flags like cb.c sets them
+static void emit_shift(Emitter *e, unsigned char op) {
+    switch (op) {
+    case 0:
+        // RLC: rol al, 1; mov r15d, eax; and r15d, 1
+        EMIT(0xD0, 0xC0, 0x41, 0x89, 0xC7, 0x41, 0x83, 0xE7, 0x01);
+        break;
+    case 1:
+        // RRC: ror al, 1; movzx r15d, al; shr r15d, 7
+        EMIT(0xD0, 0xC8, 0x44, 0x0F, 0xB6, 0xF8, 0x41, 0xC1, 0xEF, 0x07);
+        break;
+    case 2:
+        // RL: mov edx, eax; shr edx, 7; add eax, eax; or eax, r15d; mov r15d, edx
+        EMIT(0x89, 0xC2, 0xC1, 0xEA, 0x07, 0x01, 0xC0, 0x44, 0x09, 0xF8, 0x41, 0x89, 0xD7);
+        break;
+    case 3:
+        // RR: mov edx, eax; and edx, 1; shr eax, 1; mov ecx, r15d; shl ecx, 7; or eax, ecx; mov r15d, edx
+        EMIT(0x89, 0xC2, 0x83, 0xE2, 0x01, 0xD1, 0xE8, 0x44, 0x89, 0xF9, 0xC1, 0xE1, 0x07, 0x09, 0xC8);
+        EMIT(0x41, 0x89, 0xD7);
+        break;
+    case 4:
+        // SLA: mov r15d, eax; shr r15d, 7; add eax, eax
+        EMIT(0x41, 0x89, 0xC7, 0x41, 0xC1, 0xEF, 0x07, 0x01, 0xC0);
+        break;
+    case 5:
+        // SRA: mov r15d, eax; and r15d, 1; movsx eax, al; sar eax, 1
+        EMIT(0x41, 0x89, 0xC7, 0x41, 0x83, 0xE7, 0x01, 0x0F, 0xBE, 0xC0, 0xD1, 0xF8);
+        break;
+    case 6:
+        // SWAP: rol al, 4; xor r15d, r15d
+        EMIT(0xC0, 0xC0, 0x04, 0x45, 0x31, 0xFF);
+        break;
+    default:
+        // SRL: mov r15d, eax; and r15d, 1; shr eax, 1
+        EMIT(0x41, 0x89, 0xC7, 0x41, 0x83, 0xE7, 0x01, 0xD1, 0xE8);
+    }
+    store_nh(e, false, HALF_CLEAR);
+}
+
+/*
+ * Emits the instruction inline and returns its cycles, or 0 without emitting anything if it has to call its
+ * handler. memory is set for instructions that access memory, which can raise interrupts through the
+ * timer, writes for the ones that can also switch banks or overwrite cached code.
+ */
+static unsigned char emit_native(Emitter *e, Decoded *instruction, bool *memory, bool *writes) {
+    unsigned char opcode = instruction->opcode;
+    unsigned short arg = instruction->arg;
+    unsigned char dst = opcode >> 3 & 7, src = opcode & 7;
+
+    if (instruction->operand == OPERAND_CB) {
+        // (HL) operands call the handler
+        unsigned char cb = arg, r = cb & 7, bit = cb >> 3 & 7;
+        if (r == 6)
+            return 0;
+
+        load_register(e, r, EAX);
+        if (cb < 0x40) {
+            emit_shift(e, cb >> 3);
+        } else if (cb < 0x80) {
+            // BIT: shr eax, bit; and eax, 1; mov r14d, eax
+            EMIT(0xC1, 0xE8, bit, 0x83, 0xE0, 0x01, 0x41, 0x89, 0xC6);
+            store_nh(e, false, HALF_SET);
+            return 8;
+        } else if (cb < 0xC0) {
+            // RES: and eax, ~(1 << bit)
+            EMIT(0x25);
+            emit32(e, ~(1u << bit) & 0xFF);
+            store_register(e, r, EAX);
+            return 8;
+        } else {
+            // SET: or eax, 1 << bit
+            EMIT(0x0D);
+            emit32(e, 1u << bit);
+            store_register(e, r, EAX);
+            return 8;
+        }
+        // movzx r14d, al
+        EMIT(0x44, 0x0F, 0xB6, 0xF0);
+        store_register(e, r, EAX);
+        return 8;
+    }
+
+    if (opcode == 0x00)
+        return 4;
+
+    if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76) {
+        // LD r8,r8 and LD r8,(HL) and LD (HL),r8
+        if (src == 6) {
+            load_operand(e, 6, EAX);
+            store_register(e, dst, EAX);
+            *memory = true;
+            return 8;
+        }
+        load_register(e, src, EAX);
+        if (dst == 6) {
+            address_hl(e);
+            emit_write(e);
+            *memory = *writes = true;
+            return 8;
+        }
+        store_register(e, dst, EAX);
+        return 4;
+    }
+
+    if (opcode >= 0x80 && opcode < 0xC0) {
+        // ALU A,r8 and ALU A,(HL)
+        load_operand(e, src, ECX);
+        emit_alu(e, dst);
+        *memory = src == 6;
+        return src == 6 ? 8 : 4;
+    }
+
+    if (opcode >= 0xC0 && src == 6 && instruction->operand == OPERAND_d8) {
+        // ALU A,d8: mov ecx, arg
+        EMIT(0xB9);
+        emit32(e, arg);
+        emit_alu(e, dst);
+        return 8;
+    }
+
+    if (opcode < 0x40 && (src == 4 || src == 5)) {
+        // INC r8 and DEC r8, INC (HL) and DEC (HL)
+        bool dec = src == 5;
+        load_operand(e, dst, EAX);
+        store_half_carry(e, 0, EAX, dec ? HALF_SUB : HALF_ADD, dec);
+        // mov word [rbx + h_b], 1
+        EMIT(0x66, 0xC7, 0x83);
+        emit32(e, OFFSET(cpu.h_b));
+        emit16(e, 1);
+        store_byte(e, OFFSET(cpu.h_carry), 0);
+        // add eax, 1 or sub eax, 1; movzx r14d, al
+        EMIT(0x83, dec ? 0xE8 : 0xC0, 0x01, 0x44, 0x0F, 0xB6, 0xF0);
+        if (dst == 6) {
+            address_hl(e);
+            emit_write(e);
+            *memory = *writes = true;
+            return 12;
+        }
+        store_register(e, dst, EAX);
+        return 8;
+    }
+
+    if (opcode < 0x40 && src == 6) {
+        // LD r8,d8 and LD (HL),d8
+        if (dst == 6) {
+            // mov eax, arg
+            EMIT(0xB8);
+            emit32(e, arg);
+            address_hl(e);
+            emit_write(e);
+            *memory = *writes = true;
+            return 12;
+        } else if (dst < 4) {
+            store_byte(e, registers[dst], arg);
+        } else if (dst == 7) {
+            // mov r12d, arg
+            EMIT(0x41, 0xBC);
+            emit32(e, arg);
+        } else {
+            EMIT(0xB8);
+            emit32(e, arg);
+            store_register(e, dst, EAX);
+        }
+        return 8;
+    }
+
+    switch (opcode) {
+    case 0x01:
+    case 0x11:
+        // LD BC,d16 / LD DE,d16: mov word [rbx + B], arg with the bytes swapped
+        EMIT(0x66, 0xC7, 0x83);
+        emit32(e, registers[dst]);
+        emit16(e, arg >> 8 | arg << 8);
+        return 12;
+    case 0x21:
+        // LD HL,d16: mov r13d, arg
+        EMIT(0x41, 0xBD);
+        emit32(e, arg);
+        return 12;
+    case 0x31:
+        // LD SP,d16: mov word [rbx + SP], arg
+        EMIT(0x66, 0xC7, 0x83);
+        emit32(e, OFFSET(cpu.SP));
+        emit16(e, arg);
+        return 12;
+    case 0x03:
+    case 0x0B:
+    case 0x13:
+    case 0x1B:
+        // INC/DEC BC/DE: movzx ecx, word [rbx + B]; rol cx, 8; inc cx or dec cx; rol cx, 8; mov [rbx + B], cx
+        load_pair(e, registers[dst & 6]);
+        EMIT(0x66, 0xFF, opcode & 8 ? 0xC9 : 0xC1, 0x66, 0xC1, 0xC1, 0x08, 0x66, 0x89, 0x8B);
+        emit32(e, registers[dst & 6]);
+        return 8;
+    case 0x23:
+    case 0x2B:
+        step_hl(e, opcode & 8);
+        return 8;
+    case 0x33:
+    case 0x3B:
+        // inc word [rbx + SP] or dec word [rbx + SP]
+        EMIT(0x66, 0xFF, opcode & 8 ? 0x8B : 0x83);
+        emit32(e, OFFSET(cpu.SP));
+        return 8;
+    case 0x09:
+    case 0x19:
+    case 0x29:
+    case 0x39:
+        // ADD HL,r16: the operand in ecx
+        if (opcode == 0x29) {
+            address_hl(e);
+        } else if (opcode == 0x39) {
+            // movzx ecx, word [rbx + SP]
+            EMIT(0x0F, 0xB7, 0x8B);
+            emit32(e, OFFSET(cpu.SP));
+        } else {
+            load_pair(e, registers[dst & 6]);
+        }
+        store_half_carry(e, 0x44, 5, HALF_ADD16, false);
+        EMIT(0x66, 0x89, 0x8B);
+        emit32(e, OFFSET(cpu.h_b));
+        store_byte(e, OFFSET(cpu.h_carry), 0);
+        // add r13d, ecx; cmp r13d, 0xFFFF; seta r15b; movzx r13d, r13w
+        EMIT(0x41, 0x01, 0xCD, 0x41, 0x81, 0xFD, 0xFF, 0xFF, 0x00, 0x00, 0x41, 0x0F, 0x97, 0xC7, 0x45, 0x0F, 0xB7, 0xED);
+        return 8;
+    case 0x02:
+    case 0x12:
+        // LD (BC),A / LD (DE),A
+        load_pair(e, registers[dst & 6]);
+        load_register(e, 7, EAX);
+        emit_write(e);
+        *memory = *writes = true;
+        return 8;
+    case 0x0A:
+    case 0x1A:
+        // LD A,(BC) / LD A,(DE)
+        load_pair(e, registers[dst & 6]);
+        emit_read(e);
+        store_register(e, 7, EAX);
+        *memory = true;
+        return 8;
+    case 0x22:
+    case 0x32:
+        // LDI (HL),A / LDD (HL),A
+        address_hl(e);
+        load_register(e, 7, EAX);
+        emit_write(e);
+        step_hl(e, opcode == 0x32);
+        *memory = *writes = true;
+        return 8;
+    case 0x2A:
+    case 0x3A:
+        // LDI A,(HL) / LDD A,(HL)
+        address_hl(e);
+        emit_read(e);
+        store_register(e, 7, EAX);
+        step_hl(e, opcode == 0x3A);
+        *memory = true;
+        return 8;
+    case 0xE0:
+    case 0xEA:
+    case 0xE2:
+        // LDH (n),A / LD (a16),A / LD (C),A
+        if (opcode == 0xE2) {
+            // movzx ecx, byte [rbx + C]; or ecx, 0xFF00
+            load_register(e, 1, ECX);
+            EMIT(0x81, 0xC9, 0x00, 0xFF, 0x00, 0x00);
+        } else {
+            // mov ecx, address
+            EMIT(0xB9);
+            emit32(e, opcode == 0xE0 ? 0xFF00 + arg : arg);
+        }
+        load_register(e, 7, EAX);
+        emit_write(e);
+        *memory = *writes = true;
+        return opcode == 0xE0 ? 12 : opcode == 0xEA ? 16 : 8;
+    case 0xF0:
+    case 0xFA:
+    case 0xF2:
+        // LDH A,(n) / LD A,(a16) / LD A,(C)
+        if (opcode == 0xF2) {
+            load_register(e, 1, ECX);
+            EMIT(0x81, 0xC9, 0x00, 0xFF, 0x00, 0x00);
+        } else {
+            EMIT(0xB9);
+            emit32(e, opcode == 0xF0 ? 0xFF00 + arg : arg);
+        }
+        emit_read(e);
+        store_register(e, 7, EAX);
+        *memory = true;
+        return opcode == 0xF0 ? 12 : opcode == 0xFA ? 16 : 4;
+    case 0x07:
+    case 0x0F:
+    case 0x17:
+    case 0x1F:
+        // RLCA, RRCA, RLA, RRA: the CB rotation of A, but Z is always reset
+        load_register(e, 7, EAX);
+        emit_shift(e, dst);
+        store_register(e, 7, EAX);
+        // mov r14d, 1
+        EMIT(0x41, 0xBE);
+        emit32(e, 1);
+        return 4;
+    case 0x2F:
+        // CPL: xor r12d, 0xFF
+        EMIT(0x41, 0x81, 0xF4, 0xFF, 0x00, 0x00, 0x00);
+        store_nh(e, true, HALF_SET);
+        return 4;
+    case 0x37:
+        // SCF: mov r15d, 1
+        EMIT(0x41, 0xBF);
+        emit32(e, 1);
+        store_nh(e, false, HALF_CLEAR);
+        return 4;
+    case 0x3F:
+        // CCF: xor r15d, 1
+        EMIT(0x41, 0x83, 0xF7, 0x01);
+        store_nh(e, false, HALF_CLEAR);
+        return 4;
+    case 0xF3:
+    case 0xFB:
+        // DI / EI
+        store_byte(e, OFFSET(cpu.ime), opcode == 0xFB);
+        return 4;
+    }
+
+    return 0;
+}
+
+// calls the handler of the instruction with the guest state written back, the PC it sees is the next one
+static void emit_handler(Emitter *e, Decoded *instruction, unsigned short pc) {
+    // mov word [rbx + PC], pc
+    EMIT(0x66, 0xC7, 0x83);
+    emit32(e, OFFSET(cpu.PC));
+    emit16(e, pc);
+    store_state(e);
+
+    // mov rdi, rbx
+    EMIT(0x48, 0x89, 0xDF);
+    if (instruction->operand == OPERAND_d8 || instruction->operand == OPERAND_d16) {
+        // mov esi, arg
+        EMIT(0xBE);
+        emit32(e, instruction->arg);
+    }
+    emit_call(e, (void *)instruction->handler.none);
+
+    if (instruction->operand == OPERAND_CB) {
+        // add rbp, 8
+        EMIT(0x48, 0x83, 0xC5, 0x08);
+    } else {
+        // movzx eax, al; add rbp, rax
+        EMIT(0x0F, 0xB6, 0xC0, 0x48, 0x01, 0xC5);
+    }
+    load_registers(e);
+}
+
+// cmp rbp, [rbx + next]; jae exit
+static void check_events(Emitter *e, int pc) {
+    EMIT(0x48, 0x3B, 0xAB);
+    emit32(e, OFFSET(scheduler.next));
+    EMIT(0x0F, 0x83);
+    emit_exit(e, pc);
+}
+
+// cmp byte [rbx + pending], 0; jne exit
+static void check_pending(Emitter *e, int pc) {
+    EMIT(0x80, 0xBB);
+    emit32(e, OFFSET(cpu.pending));
+    EMIT(0x00, 0x0F, 0x85);
+    emit_exit(e, pc);
+}
+
+/*
+ * JR, JP and their conditional forms at the end of a block, false for other instructions. Jumps back to
+ * the start of the block loop without leaving it, with the checks next_instructions does before it runs
+ * the block again.
+ */
+static bool emit_jump(Emitter *e, Block *block, Decoded *instruction, unsigned short pc) {
+    unsigned char opcode = instruction->opcode;
+    unsigned short target;
+    unsigned char taken, not_taken;
+
+    if (opcode == 0x18 || (opcode & 0xE7) == 0x20) {
+        target = pc + (signed char)instruction->arg;
+        taken = 12;
+        not_taken = 8;
+    } else if (opcode == 0xC3 || (opcode & 0xE7) == 0xC2) {
+        target = instruction->arg;
+        taken = 16;
+        not_taken = 12;
+    } else {
+        return false;
+    }
+
+    if (opcode != 0x18 && opcode != 0xC3) {
+        // add rbp, not_taken; test r14d, r14d or test r15d, r15d
+        EMIT(0x48, 0x83, 0xC5, not_taken, 0x45, 0x85, opcode & 0x10 ? 0xFF : 0xF6);
+        // leave if the condition does not hold: Z is set if z_result is 0, C if c_flag is not, bit 3 clear negates
+        bool z = (opcode & 0x10) == 0;
+        EMIT(0x0F, (opcode & 8 ? !z : z) ? 0x84 : 0x85);
+        emit_exit(e, pc);
+        taken -= not_taken;
+    }
+    // add rbp, taken
+    EMIT(0x48, 0x83, 0xC5, taken);
+
+    if (target == block->pc) {
+        check_events(e, target);
+        // cmp byte [rbx + pending], 0; je loop; cmp byte [rbx + ime], 0; jne exit, the interrupt is taken
+        EMIT(0x80, 0xBB);
+        emit32(e, OFFSET(cpu.pending));
+        EMIT(0x00, 0x74);
+        unsigned char *loop = skip(e);
+        EMIT(0x80, 0xBB);
+        emit32(e, OFFSET(cpu.ime));
+        EMIT(0x00, 0x0F, 0x85);
+        emit_exit(e, target);
+        land(e, loop);
+        // jmp start
+        EMIT(0xE9);
+        emit32(e, e->start - (e->code + 4));
+        return true;
+    }
+
+    EMIT(0xE9);
+    emit_exit(e, target);
+    return true;
+}
+
+static void emit_instruction(Emitter *e, Block *block, Decoded *instruction, unsigned short pc) {
+    bool first = instruction == block->instructions;
+    bool last = instruction == block->instructions + block->count - 1;
+
+    if (last && emit_jump(e, block, instruction, pc))
+        return;
+
+    bool memory = false, writes = false;
+    unsigned char cycles = emit_native(e, instruction, &memory, &writes);
+    if (cycles > 0) {
+        // add rbp, cycles
+        EMIT(0x48, 0x83, 0xC5, cycles);
+    } else {
+        emit_handler(e, instruction, pc);
+        if (last) {
+            // the handler may have jumped
+            EMIT(0xE9);
+            emit_exit(e, -1);
+            return;
+        }
+        memory = writes = true;
+    }
+
+    if (last) {
+        EMIT(0xE9);
+        emit_exit(e, pc);
+        return;
+    }
+
+    check_events(e, pc);
+
+    // writes may switch the ROM bank or overwrite the block
+    if (writes && block->pc >= 0x4000 && block->pc < 0x8000) {
+        // cmp byte [rbx + rom_bank_number], bank; jne exit
+        EMIT(0x80, 0xBB);
+        emit32(e, OFFSET(mmu.mbc.rom_bank_number));
+        EMIT(block->bank, 0x0F, 0x85);
+        emit_exit(e, pc);
+    } else if (writes && block->pc >= 0x8000) {
+        // cmp dword [rbx + generation], generation; jne exit
+        EMIT(0x81, 0xBB);
+        emit32(e, OFFSET(cache.generation));
+        emit32(e, block->generation);
+        EMIT(0x0F, 0x85);
+        emit_exit(e, pc);
+    }
+
+    // an interrupt pending on entry leaves after the first instruction, later ones can only be raised by IO
+    if (first || memory)
+        check_pending(e, pc);
+}
+
+// upper bound of the code emitted for one instruction
+#define MAX_INSTRUCTION_SIZE 320
+
+static void flush(Gameboy *gb) {
+    for (int i = 0; i < BLOCK_CACHE_SIZE; i++) {
+        gb->cache.blocks[i].code = NULL;
+        gb->cache.blocks[i].hits = 0;
+    }
+    gb->jit.used = 0;
+}
+
+// the buffer is only writable while a block is emitted and only executable otherwise
+Compiled jit_compile(Gameboy *gb, Block *block) {
+    if (gb->jit.buffer == NULL) {
+        void *buffer = mmap(NULL, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer == MAP_FAILED)
+            return NULL;
+        gb->jit.buffer = buffer;
+        gb->jit.used = 0;
+    } else if (mprotect(gb->jit.buffer, JIT_BUFFER_SIZE, PROT_READ | PROT_WRITE) != 0) {
+        return NULL;
+    }
+
+    if (gb->jit.used + block->count * MAX_INSTRUCTION_SIZE + 128 > JIT_BUFFER_SIZE)
+        flush(gb);
+
+    Emitter emitter = {.code = gb->jit.buffer + gb->jit.used};
+    Emitter *e = &emitter;
+    unsigned char *start = e->code;
+
+    // push rbx; push rbp; push r12; push r13; push r14; push r15; sub rsp, 8; mov rbx, rdi
+    EMIT(0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57, 0x48, 0x83, 0xEC, 0x08, 0x48, 0x89, 0xFB);
+    // mov rbp, [rbx + now]
+    EMIT(0x48, 0x8B, 0xAB);
+    emit32(e, OFFSET(scheduler.now));
+    load_registers(e);
+    e->start = e->code;
+
+    unsigned short pc = block->pc;
+    for (Decoded *instruction = block->instructions; instruction < block->instructions + block->count; instruction++) {
+        pc += instruction->length;
+        emit_instruction(e, block, instruction, pc);
+    }
+
+    unsigned char *epilogue = e->code;
+    store_state(e);
+    // add rsp, 8; pop r15; pop r14; pop r13; pop r12; pop rbp; pop rbx; ret
+    EMIT(0x48, 0x83, 0xC4, 0x08, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B, 0xC3);
+
+    // exits that still have to set the PC go through a stub: mov word [rbx + PC], pc; jmp epilogue
+    for (unsigned char i = 0; i < e->count; i++) {
+        unsigned char *target = epilogue;
+        if (e->exits[i].pc >= 0) {
+            target = e->code;
+            EMIT(0x66, 0xC7, 0x83);
+            emit32(e, OFFSET(cpu.PC));
+            emit16(e, e->exits[i].pc);
+            EMIT(0xE9);
+            emit32(e, epilogue - (e->code + 4));
+        }
+        int rel = target - (e->exits[i].site + 4);
+        memcpy(e->exits[i].site, &rel, 4);
+    }
+
+    gb->jit.used = (e->code - gb->jit.buffer + 15) & ~(size_t)15;
+
+    if (mprotect(gb->jit.buffer, JIT_BUFFER_SIZE, PROT_READ | PROT_EXEC) != 0) {
+        // nothing in the buffer can run any more
+        flush(gb);
+        return NULL;
+    }
+
+    return (Compiled)start;
+}
+
+void jit_free(Gameboy *gb) {
+    if (gb->jit.buffer != NULL)
+        munmap(gb->jit.buffer, JIT_BUFFER_SIZE);
+    gb->jit.buffer = NULL;
+    gb->jit.used = 0;
+#ifdef JIT_CHECK
+    free_shadow(gb);
+#endif
+}
+
+#else
+
+Compiled jit_compile(Gameboy *gb, Block *block) {
+    (void)gb;
+    (void)block;
+    return NULL;
+}
+
+void jit_free(Gameboy *gb) {
+#ifdef JIT_CHECK
+    free_shadow(gb);
+#endif
+    (void)gb;
+}
+
+#endif
+
+#endif
\ No newline at end of file
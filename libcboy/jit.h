@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIBCBOY_JIT_H
+#define LIBCBOY_JIT_H
+
+#include <stddef.h>
+
+#include "cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// executions of a cached block before it gets compiled
+#define JIT_THRESHOLD 64
+// blocks in RAM are often rewritten before they pay back a compile
+#define JIT_RAM_THRESHOLD 1024
+#define JIT_BUFFER_SIZE (4 << 20)
+
+typedef struct {
+    unsigned char *buffer;
+    size_t used;
+#ifdef JIT_CHECK
+    Gameboy *shadow;
+#endif
+} Jit;
+
+/*
+ * Translates a decoded block to native code, NULL if the host is not supported or the
+ * code buffer can not be allocated, in which case the block keeps running interpreted.
+ */
+Compiled jit_compile(Gameboy *gb, Block *block);
+
+// releases the code buffer, called by unload_rom
+void jit_free(Gameboy *gb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCBOY_JIT_H
\ No newline at end of file
@@ -1,20 +1,64 @@
 // SPDX-License-Identifier: GPL-3.0-only
 
+#include <stdlib.h>
+
 #include "gameboy.h"
 
-unsigned char read_mbc(unsigned short addr) {
+unsigned int mbc_offset(Gameboy *gb, unsigned short addr) {
     if (addr < 0x4000) {
-        return gameboy.mmu.mbc.rom[addr];
+        return addr;
     }
-    return gameboy.mmu.mbc.rom[(gameboy.mmu.mbc.rom_bank_number - 1) * 0x4000 + addr];
+    return gb->mmu.mbc.rom_bank_number % gb->mmu.mbc.rom_banks * 0x4000 + addr - 0x4000;
+}
+
+unsigned int mbc_ram_offset(Gameboy *gb, unsigned short addr) {
+    return gb->mmu.mbc.ram_bank_number % (gb->mmu.mbc.ram_size / 0x2000) * 0x2000 + addr - 0xA000;
+}
+
+/*
+ * 0149 - RAM Size
+ *   00h - None, 01h - 2 KBytes, 02h - 8 KBytes, 03h - 32 KBytes (4 banks of 8KBytes each),
+ *   04h - 128 KBytes (16 banks of 8KBytes each), 05h - 64 KBytes (8 banks of 8KBytes each)
+ */
+void init_mbc_ram(Gameboy *gb) {
+    static const unsigned int sizes[6] = {0, 0x2000, 0x2000, 0x8000, 0x20000, 0x10000};
+    unsigned char type = gb->mmu.mbc.rom[0x149];
+
+    // 2 KBytes are allocated as a whole bank, A000-BFFF is mapped in pages
+    gb->mmu.mbc.ram_size = type < 6 ? sizes[type] : 0;
+    gb->mmu.mbc.ram = gb->mmu.mbc.ram_size > 0 ? calloc(gb->mmu.mbc.ram_size, 1) : NULL;
+}
+
+// A000-BFFF only gets here while the external RAM is disabled, it reads FF and ignores writes
+unsigned char read_mbc(Gameboy *gb, unsigned short addr) {
+    return addr < 0x8000 ? gb->mmu.mbc.rom[mbc_offset(gb, addr)] : 0xFF;
 }
 
-void write_mbc(unsigned short addr, unsigned char value) {
-    if (addr >= 0x2000 && addr < 0x4000) {
-        gameboy.mmu.mbc.rom_bank_number = value > 1 ? value : 1;
+void write_mbc(Gameboy *gb, unsigned short addr, unsigned char value) {
+    if (addr < 0x2000) {
+        // 0A in the lower 4 bits enables the external RAM, anything else disables it
+        bool enable = (value & 0x0F) == 0x0A;
+        if (enable != gb->mmu.mbc.ram_enable && gb->mmu.mbc.ram != NULL) {
+            gb->mmu.mbc.ram_enable = enable;
+            map_memory(gb, 0xA0, 0xBF);
+#ifdef BLOCK_CACHE
+            // code cached from A000-BFFF is gone
+            invalidate_blocks(gb);
+#endif
+        }
+    } else if (addr < 0x4000) {
+        gb->mmu.mbc.rom_bank_number = value > 1 ? value : 1;
+        map_memory(gb, 0x40, 0x7F);
     } else if (addr < 0x6000) {
-        gameboy.mmu.mbc.ram_bank_number = value;
+        gb->mmu.mbc.ram_bank_number = value;
+        if (gb->mmu.mbc.ram_size > 0x2000) {
+            map_memory(gb, 0xA0, 0xBF);
+#ifdef BLOCK_CACHE
+            // code cached from A000-BFFF is gone
+            invalidate_blocks(gb);
+#endif
+        }
     } else if (addr < 0x8000) {
-        gameboy.mmu.mbc.rom_ram_select = value;
+        gb->mmu.mbc.rom_ram_select = value;
     }
 }
\ No newline at end of file
@@ -6,7 +6,9 @@
 typedef struct {
     char *filename;
     unsigned char *rom;
-    unsigned char ram[4][0x2000];
+    unsigned int rom_banks; // in the memory map_rom returned, bank numbers wrap around at it
+    unsigned char *ram; // external RAM, NULL if the cartridge has none
+    unsigned int ram_size;
 
     unsigned char rom_bank_number;
     unsigned char ram_bank_number;
@@ -14,8 +16,20 @@ typedef struct {
     bool ram_enable;
 } Mbc;
 
-unsigned char read_mbc(unsigned short addr);
+typedef struct Gameboy Gameboy;
 
-void write_mbc(unsigned short addr, unsigned char value);
+// offset of addr into the ROM with the current bank mapped to 4000-7FFF
+unsigned int mbc_offset(Gameboy *gb, unsigned short addr);
+
+// offset of addr in A000-BFFF into the external RAM with the current RAM bank mapped
+unsigned int mbc_ram_offset(Gameboy *gb, unsigned short addr);
+
+// allocates the external RAM for the size in the cartridge header
+void init_mbc_ram(Gameboy *gb);
+
+// 0000-7FFF, and A000-BFFF while the external RAM is disabled
+unsigned char read_mbc(Gameboy *gb, unsigned short addr);
+
+void write_mbc(Gameboy *gb, unsigned short addr, unsigned char value);
 
 #endif // LIBCBOY_MBC_H
@@ -4,147 +4,370 @@
 
 #include "gameboy.h"
 
-unsigned char read_mmu(unsigned short addr) {
-    if (addr < 0x8000)
-        return read_mbc(addr);
+void map_memory(Gameboy *gb, unsigned char first, unsigned char last) {
+    Mmu *mmu = &gb->mmu;
 
-    if (addr == 0xFF69) {
-        unsigned char bcps = read_mmu(0xFF68);
-        return gameboy.mmu.bg_palette[bcps & 0x3f];
+    for (unsigned int i = first; i <= last; i++) {
+        unsigned short addr = i << 8;
+        unsigned char *page;
+
+        if (addr < 0x8000)
+            page = mmu->mbc.rom == NULL ? NULL : mmu->mbc.rom + mbc_offset(gb, addr);
+        else if (addr >= 0xFF00)
+            page = NULL;
+        else if (addr >= 0xA000 && addr <= 0xBFFF && mmu->mbc.ram != NULL)
+            page = mmu->mbc.ram_enable ? mmu->mbc.ram + mbc_ram_offset(gb, addr) : NULL;
+        else if (gb->cgb && addr <= 0x9FFF && mmu->ram[0xFF4F - 0x8000] & 1)
+            page = mmu->vram_bank + addr - 0x8000;
+        else if (gb->cgb && addr >= 0xD000 && addr <= 0xDFFF)
+            page = mmu->wram[mmu->ram[0xFF70 - 0x8000] > 0 ? mmu->ram[0xFF70 - 0x8000] - 1 : 0] + addr - 0xD000;
+        else
+            page = mmu->ram + addr - 0x8000;
+
+        gb->map.read[i] = page;
+        // ROM writes go to the MBC, writes to tile data have to drop the decoded tiles
+        gb->map.write[i] = addr < 0x9800 ? NULL : page;
+
+        // the pipeline records all writes to VRAM and OAM
+        if (gb->display.pipeline != NULL && (addr < 0xA000 || addr == 0xFE00))
+            gb->map.write[i] = NULL;
+
+#ifdef BLOCK_CACHE
+        // writes to cached code have to drop the blocks
+        if (addr >= 0x8000) {
+            for (unsigned int j = 0; j < 0x100 / 8; j++) {
+                if (gb->cache.code[((addr - 0x8000) >> 3) + j]) {
+                    gb->map.write[i] = NULL;
+                    break;
+                }
+            }
+        }
+#endif
     }
+}
+
+/*
+ * IO registers with side effects. Everything without a handler is a plain register in mmu.ram.
+ */
+
+// FF00 - P1/JOYP - Joypad (R/W)
+static void write_joypad(Gameboy *gb, unsigned char value) {
+    bool buttons_selected = ((value >> 5) & 1) == 0;
+    bool directions_selected = ((value >> 4) & 1) == 0;
 
-    if (addr == 0xFF6B) {
-        unsigned char ocps = read_mmu(0xFF6A);
-        return gameboy.mmu.sprite_palette[ocps & 0x3f];
+    if (buttons_selected && !directions_selected) {
+        value |= gb->controls >> 4;
+    } else if (directions_selected && !buttons_selected) {
+        value |= gb->controls & 0xF;
+    } else {
+        value |= 0xF;
     }
+    gb->mmu.ram[0xFF00 - 0x8000] = value;
+}
+
+// FF02 - SC - Serial Transfer Control (R/W)
+static void write_serial(Gameboy *gb, unsigned char value) {
+    gb->mmu.ram[0xFF02 - 0x8000] = value;
+
+    // Bit 7 - Transfer Start Flag, 8 bits at 8192Hz
+    if (value >> 7 & 1)
+        schedule(gb, EVENT_SERIAL, gb->scheduler.now + 8 * 512);
+}
+
+void serial_event(Gameboy *gb, unsigned long long when) {
+    (void)when;
+    serial_print(gb, gb->mmu.ram[0xFF01 - 0x8000]);
+
+    // nothing is connected, the bits shifted in are all 1
+    gb->mmu.ram[0xFF01 - 0x8000] = 0xFF;
+    gb->mmu.ram[0xFF02 - 0x8000] &= 0x7F;
+    set_interrupt(gb, 3);
+}
+
+// FF0F - IF - Interrupt Flag (R/W)
+static void write_interrupt_flag(Gameboy *gb, unsigned char value) {
+    gb->mmu.ram[0xFF0F - 0x8000] = value;
+    update_interrupts(gb);
+}
+
+void update_interrupts(Gameboy *gb) {
+    gb->cpu.pending = gb->mmu.ram[0xFFFF - 0x8000] & gb->mmu.ram[0xFF0F - 0x8000] & 0x1F;
+}
 
-    if (gameboy.cgb) {
-        // CGB VRAM
-        if (addr >= 0x8000 && addr <= 0x9FFF && read_mmu(0xFF4F) & 1)
-            return gameboy.mmu.vram_bank[addr - 0x8000];
-
-        // CGB WRAM
-        if (addr >= 0xD000 && addr <= 0xDFFF) {
-            unsigned char bank = read_mmu(0xFF70);
-            if (bank > 0)
-                bank--;
-            return gameboy.mmu.wram[bank][addr - 0xD000];
+void set_interrupt(Gameboy *gb, unsigned char value) {
+    gb->mmu.ram[0xFF0F - 0x8000] |= 1 << value;
+    update_interrupts(gb);
+}
+
+/*
+ * Copies length bytes with one memmove per pair of resolved pages. Pages without host memory, like the
+ * IO registers or RAM that holds cached code, are copied byte by byte through read_mmu and write_mmu.
+ */
+static void copy_memory(Gameboy *gb, unsigned short target, unsigned short source, unsigned short length) {
+    while (length > 0) {
+        unsigned short chunk = length;
+        if (chunk > 0x100 - (source & 0xFF))
+            chunk = 0x100 - (source & 0xFF);
+        if (chunk > 0x100 - (target & 0xFF))
+            chunk = 0x100 - (target & 0xFF);
+
+        unsigned char *from = gb->map.read[source >> 8];
+        unsigned char *to = gb->map.write[target >> 8];
+
+        if (to == NULL && target >= 0x8000 && target < 0x9800 && gb->display.pipeline == NULL) {
+            // tile data, the read page is the same memory
+            to = gb->map.read[target >> 8];
+            invalidate_tiles(gb, target, chunk);
         }
 
-        // FF4D - KEY1 - CGB Mode Only - Prepare Speed Switch
-        // FIXME
-        if (addr == 0xFF4D) {
-            if (gameboy.mmu.ram[addr - 0x8000] & 1)
-                return 1 << 7;
-            else
-                return 0;
+        if (from != NULL && to != NULL) {
+            memmove(to + (target & 0xFF), from + (source & 0xFF), chunk);
+        } else {
+            for (unsigned short i = 0; i < chunk; i++)
+                write_mmu(gb, target + i, read_mmu(gb, source + i));
         }
 
-        // FIXME
-        if (addr == 0xFF55)
-            return 1 << 7;
+        source += chunk;
+        target += chunk;
+        length -= chunk;
     }
+}
 
-    return gameboy.mmu.ram[addr - 0x8000];
+// FF46 - DMA - DMA Transfer and Start Address (W), the transfer takes 160 machine cycles
+static void write_dma(Gameboy *gb, unsigned char value) {
+    gb->mmu.ram[0xFF46 - 0x8000] = value;
+    schedule(gb, EVENT_DMA, gb->scheduler.now + 160 * 4);
 }
 
-void write_mmu(unsigned short addr, unsigned char value) {
-    if (addr < 0x8000) {
-        // MBC
-        write_mbc(addr, value);
-        return;
-    }
+void dma_event(Gameboy *gb, unsigned long long when) {
+    (void)when;
+    copy_memory(gb, 0xFE00, gb->mmu.ram[0xFF46 - 0x8000] << 8, 0xA0);
+}
 
-    if (addr == 0xFF00) {
-        // controls
-        bool buttons_selected = ((value >> 5) & 1) == 0;
-        bool directions_selected = ((value >> 4) & 1) == 0;
+// FF4D - KEY1 - CGB Mode Only - Prepare Speed Switch
+// FIXME
+static unsigned char read_key1(Gameboy *gb) {
+    if (gb->mmu.ram[0xFF4D - 0x8000] & 1)
+        return 1 << 7;
+    else
+        return 0;
+}
 
-        if (buttons_selected && !directions_selected) {
-            value |= gameboy.controls >> 4;
-        } else if (directions_selected && !buttons_selected) {
-            value |= gameboy.controls & 0xF;
-        } else {
-            value |= 0xF;
-        }
-        gameboy.mmu.ram[addr - 0x8000] = value;
-        return;
+// FF4F - VBK - CGB Mode Only - VRAM Bank
+static void write_vram_bank(Gameboy *gb, unsigned char value) {
+    gb->mmu.ram[0xFF4F - 0x8000] = value;
+    map_memory(gb, 0x80, 0x9F);
+}
+
+/*
+ * FF51, FF52 - HDMA1, HDMA2 - CGB Mode Only - New DMA Source, High, Low
+ * FF53, FF54 - HDMA3, HDMA4 - CGB Mode Only - New DMA Destination, High, Low
+ *
+ * The lower 4 bits are ignored, the destination is always in VRAM. Both advance while the transfer
+ * runs, so that an H-Blank DMA continues where it left off.
+ */
+static void transfer_hdma(Gameboy *gb, unsigned char blocks) {
+    unsigned char *hdma = gb->mmu.ram + 0xFF51 - 0x8000;
+    unsigned short source = (hdma[0] << 8 | hdma[1]) & 0xFFF0;
+    unsigned short target = 0x8000 | ((hdma[2] << 8 | hdma[3]) & 0x1FF0);
+    unsigned short length = blocks * 0x10;
+
+    // the transfer stops at the end of VRAM
+    copy_memory(gb, target, source, length < 0xA000 - target ? length : 0xA000 - target);
+
+    source += length;
+    target += length;
+    hdma[0] = source >> 8;
+    hdma[1] = source & 0xFF;
+    hdma[2] = target >> 8;
+    hdma[3] = target & 0xFF;
+}
+
+/*
+ * FF55 - HDMA5 - CGB Mode Only - New DMA Length/Mode/Start
+ *   Bit 7    - 0=General Purpose DMA, copies everything at once
+ *              1=H-Blank DMA, copies 10h bytes in every H-Blank, see hdma_hblank
+ *   Bits 6-0 - Length/10h-1
+ *
+ * Reads the remaining length with bit 7 cleared while an H-Blank DMA is active, FFh otherwise.
+ * Writing bit 7 = 0 during an H-Blank DMA stops it.
+ */
+static void write_hdma(Gameboy *gb, unsigned char value) {
+    unsigned char *hdma5 = &gb->mmu.ram[0xFF55 - 0x8000];
+
+    if (value >> 7 & 1) {
+        *hdma5 = value & 0x7F;
+    } else if (*hdma5 >> 7 & 1) {
+        transfer_hdma(gb, (value & 0x7F) + 1);
+        *hdma5 = 0xFF;
+    } else {
+        *hdma5 |= 0x80;
     }
+}
 
-    if (addr == 0xFF02) {
-        // serial
-        serial_print(gameboy.mmu.ram[0xFF01 - 0x8000]);
+void hdma_hblank(Gameboy *gb) {
+    unsigned char *hdma5 = &gb->mmu.ram[0xFF55 - 0x8000];
+    if (!gb->cgb || *hdma5 >> 7 & 1)
         return;
-    }
 
-    if (addr == 0xFF04) {
-        // timer
-        gameboy.mmu.ram[0xFF04 - 0x8000] = 0;
+    transfer_hdma(gb, 1);
+    *hdma5 = *hdma5 > 0 ? *hdma5 - 1 : 0xFF;
+}
+
+// FF69 - BCPD/BGPD - CGB Mode Only - Background Palette Data
+static unsigned char read_bg_palette(Gameboy *gb) {
+    unsigned char bcps = read_mmu(gb, 0xFF68);
+    return gb->mmu.bg_palette[bcps & 0x3f];
+}
+
+static void write_bg_palette(Gameboy *gb, unsigned char value) {
+    unsigned char bcps = read_mmu(gb, 0xFF68);
+    gb->mmu.bg_palette[bcps & 0x3f] = value;
+
+    // Bit 7     Auto Increment  (0=Disabled, 1=Increment after Writing)
+    if (bcps >> 7 & 1)
+        write_mmu(gb, 0xFF68, bcps + 1);
+}
+
+// FF6B - OCPD/OBPD - CGB Mode Only - Sprite Palette Data
+static unsigned char read_sprite_palette(Gameboy *gb) {
+    unsigned char ocps = read_mmu(gb, 0xFF6A);
+    return gb->mmu.sprite_palette[ocps & 0x3f];
+}
+
+static void write_sprite_palette(Gameboy *gb, unsigned char value) {
+    unsigned char ocps = read_mmu(gb, 0xFF6A);
+    gb->mmu.sprite_palette[ocps & 0x3f] = value;
+
+    // Bit 7     Auto Increment  (0=Disabled, 1=Increment after Writing)
+    if (ocps >> 7 & 1)
+        write_mmu(gb, 0xFF6A, ocps + 1);
+}
+
+// FF70 - SVBK - CGB Mode Only - WRAM Bank
+static void write_wram_bank(Gameboy *gb, unsigned char value) {
+    gb->mmu.ram[0xFF70 - 0x8000] = value;
+    map_memory(gb, 0xD0, 0xDF);
+#ifdef BLOCK_CACHE
+    // code cached from D000-DFFF is gone
+    invalidate_blocks(gb);
+#endif
+}
+
+static void register_io(Gameboy *gb, unsigned short addr, IoRead read, IoWrite write) {
+    gb->io.read[addr - 0xFF00] = read;
+    gb->io.write[addr - 0xFF00] = write;
+}
+
+void init_io(Gameboy *gb) {
+    memset(&gb->io, 0, sizeof(IoPorts));
+
+    register_io(gb, 0xFF00, NULL, write_joypad);
+    register_io(gb, 0xFF02, NULL, write_serial);
+    register_io(gb, 0xFF04, read_div, write_div);
+    register_io(gb, 0xFF05, read_tima, write_tima);
+    register_io(gb, 0xFF06, NULL, write_tma);
+    register_io(gb, 0xFF07, NULL, write_tac);
+    register_io(gb, 0xFF0F, NULL, write_interrupt_flag);
+    register_io(gb, 0xFF46, NULL, write_dma);
+
+    if (!gb->cgb)
         return;
+
+    register_io(gb, 0xFF4D, read_key1, NULL);
+    register_io(gb, 0xFF4F, NULL, write_vram_bank);
+    register_io(gb, 0xFF55, NULL, write_hdma);
+    register_io(gb, 0xFF69, read_bg_palette, write_bg_palette);
+    register_io(gb, 0xFF6B, read_sprite_palette, write_sprite_palette);
+    register_io(gb, 0xFF70, NULL, write_wram_bank);
+}
+
+unsigned char read_mmu(Gameboy *gb, unsigned short addr) {
+    unsigned char *page = gb->map.read[addr >> 8];
+    if (page != NULL)
+        return page[addr & 0xFF];
+
+    if (addr >= 0xFF80) {
+        // HRAM and IE
+        return gb->mmu.ram[addr - 0x8000];
     }
 
-    if (addr == 0xFF46) {
-        // DMA
-        for (unsigned char i = 0; i <= 0x9F; i++) {
-            write_mmu(0xFE00 + i, read_mmu((value << 8) + i));
-        }
-        return;
+    if (addr >= 0xFF00) {
+        IoRead read = gb->io.read[addr - 0xFF00];
+        return read != NULL ? read(gb) : gb->mmu.ram[addr - 0x8000];
     }
 
-    if (!gameboy.cgb) {
-        gameboy.mmu.ram[addr - 0x8000] = value;
-        return;
+    // ROM while none is loaded, or the disabled external RAM
+    return read_mbc(gb, addr);
+}
+
+// the byte an IO write changes when it is one that drawing depends on
+static unsigned char *drawing_register(Gameboy *gb, unsigned short addr) {
+    switch (addr) {
+        case 0xFF40:
+        case 0xFF47:
+        case 0xFF48:
+        case 0xFF49:
+            return &gb->mmu.ram[addr - 0x8000];
+        case 0xFF69:
+            return &gb->mmu.bg_palette[gb->mmu.ram[0xFF68 - 0x8000] & 0x3F];
+        case 0xFF6B:
+            return &gb->mmu.sprite_palette[gb->mmu.ram[0xFF6A - 0x8000] & 0x3F];
     }
+    return NULL;
+}
 
-    // Color
-    if (addr >= 0x8000 && addr <= 0x9FFF && read_mmu(0xFF4F) & 1) {
-        // CGB VRAM
-        gameboy.mmu.vram_bank[addr - 0x8000] = value;
+void write_mmu(Gameboy *gb, unsigned short addr, unsigned char value) {
+    unsigned char *page = gb->map.write[addr >> 8];
+    if (page != NULL) {
+        page[addr & 0xFF] = value;
         return;
     }
 
-    if (addr >= 0xD000 && addr <= 0xDFFF) {
-        // CGB WRAM
-        unsigned char bank = read_mmu(0xFF70);
-        if (bank > 0)
-            bank--;
-        gameboy.mmu.wram[bank][addr - 0xD000] = value;
+    if (addr < 0x8000 || (addr >= 0xA000 && addr < 0xC000 && gb->map.read[addr >> 8] == NULL)) {
+        // MBC, or the external RAM while it is disabled
+        write_mbc(gb, addr, value);
         return;
     }
 
-    if (addr == 0xFF55) {
-        // CGB DMA
-        unsigned short source = (read_mmu(0xFF51) << 8) | read_mmu(0xFF52);
-        unsigned short target = (read_mmu(0xFF53) << 8) | read_mmu(0xFF54);
-        unsigned short len = ((value & 0x7f) + 1) * 0x10;
+#ifdef BLOCK_CACHE
+    // self modifying code, drop the cached blocks
+    if (gb->cache.code[(addr - 0x8000) >> 3] >> (addr & 7) & 1)
+        invalidate_blocks(gb);
+#endif
 
-        for (unsigned short i = 0; i < len; i++) {
-            write_mmu(target + i, read_mmu(source + i));
-        }
+    if (addr >= 0xFF80) {
+        // HRAM and IE
+        gb->mmu.ram[addr - 0x8000] = value;
+        if (addr == 0xFFFF)
+            update_interrupts(gb);
         return;
     }
 
-    if (addr == 0xFF69) {
-        unsigned char bcps = read_mmu(0xFF68);
-        gameboy.mmu.bg_palette[bcps & 0x3f] = value;
+    if (addr >= 0xFF00) {
+        unsigned char *target = drawing_register(gb, addr);
 
-        // Bit 7     Auto Increment  (0=Disabled, 1=Increment after Writing)
-        if (bcps >> 7 & 1)
-            write_mmu(0xFF68, bcps + 1);
+        IoWrite write = gb->io.write[addr - 0xFF00];
+        if (write != NULL)
+            write(gb, value);
+        else
+            gb->mmu.ram[addr - 0x8000] = value;
 
+        if (target != NULL) {
+            update_colors(gb, target);
+            if (gb->display.pipeline != NULL)
+                record_write(gb, target);
+        }
         return;
     }
 
-    if (addr == 0xFF6B) {
-        unsigned char ocps = read_mmu(0xFF6A);
-        gameboy.mmu.sprite_palette[ocps & 0x3f] = value;
-
-        // Bit 7     Auto Increment  (0=Disabled, 1=Increment after Writing)
-        if (ocps >> 7 & 1)
-            write_mmu(0xFF6A, ocps + 1);
+    if (addr < 0x9800)
+        invalidate_tiles(gb, addr, 1);
 
-        return;
-    }
+    // VRAM, OAM or RAM holding cached code, the read page is the same memory
+    unsigned char *target = &gb->map.read[addr >> 8][addr & 0xFF];
+    *target = value;
 
-    gameboy.mmu.ram[addr - 0x8000] = value;
+    if (gb->display.pipeline != NULL && (addr < 0xA000 || (addr >= 0xFE00 && addr < 0xFEA0)))
+        record_write(gb, target);
 }
\ No newline at end of file
@@ -7,21 +7,61 @@
 
 #include "mbc.h"
 
+typedef struct Gameboy Gameboy;
+
 typedef struct {
+    Mbc mbc;
     unsigned char ram[0x8000];
     unsigned char vram_bank[0x2000];
     unsigned char wram[7][0x1000];
-    unsigned char bg_palette[0x1000];
-    unsigned char sprite_palette[0x1000];
-    Mbc mbc;
+    unsigned char bg_palette[0x40];     // 8 palettes of 4 colors, 2 bytes each
+    unsigned char sprite_palette[0x40];
 } Mmu;
 
-unsigned char read_mmu(unsigned short addr);
-void write_mmu(unsigned short addr, unsigned char value);
+/*
+ * Host memory behind every 256 byte page of the address space, so that plain RAM and ROM accesses
+ * are a single indexed load. Pages are NULL where an access has side effects and takes the slow path:
+ * MBC registers, IO registers and, for writes, RAM that holds cached code.
+ */
+typedef struct {
+    unsigned char *read[0x100];
+    unsigned char *write[0x100];
+} MemoryMap;
+
+typedef unsigned char (*IoRead)(Gameboy *gb);
+typedef void (*IoWrite)(Gameboy *gb, unsigned char value);
+
+/*
+ * Handlers of the IO registers FF00-FF7F, registered for the hardware model by init_io.
+ * Registers without a handler read and write mmu.ram like HRAM and IE do.
+ */
+typedef struct {
+    IoRead read[0x80];
+    IoWrite write[0x80];
+} IoPorts;
+
+unsigned char read_mmu(Gameboy *gb, unsigned short addr);
+void write_mmu(Gameboy *gb, unsigned short addr, unsigned char value);
+
+// rebuilds the pages first to last (inclusive) from the current MBC, VRAM and WRAM banks
+void map_memory(Gameboy *gb, unsigned char first, unsigned char last);
+
+// registers the IO handlers of the DMG, plus the CGB only registers if gb->cgb is set
+void init_io(Gameboy *gb);
+
+// completion of the OAM DMA and serial transfers started by IO writes
+void dma_event(Gameboy *gb, unsigned long long when);
+void serial_event(Gameboy *gb, unsigned long long when);
 
-inline void set_interrupt(unsigned char value) { write_mmu(0xFF0F, read_mmu(0xFF0F) | (1 << value)); }
-inline void set_vblank() { set_interrupt(0); }
-inline void set_lcd_stat() { set_interrupt(1); }
+// copies the next 10h bytes of an active H-Blank DMA, called at the start of every H-Blank
+void hdma_hblank(Gameboy *gb);
+
+// recomputes cpu.pending from FFFF - IE and FF0F - IF
+void update_interrupts(Gameboy *gb);
+
+void set_interrupt(Gameboy *gb, unsigned char value);
+inline void set_vblank(Gameboy *gb) { set_interrupt(gb, 0); }
+inline void set_lcd_stat(Gameboy *gb) { set_interrupt(gb, 1); }
 
 /*
  * FF41 - STAT - LCDC Status (R/W)
@@ -36,57 +76,49 @@ inline void set_lcd_stat() { set_interrupt(1); }
  *       2: During Searching OAM-RAM
  *       3: During Transfering Data to LCD Driver
  */
-inline void set_mode(unsigned char mode) {
-    unsigned char value = read_mmu(0xFF41) & 3; // get 2-LSB
+inline void set_mode(Gameboy *gb, unsigned char mode) {
+    unsigned char value = read_mmu(gb, 0xFF41) & 3; // get 2-LSB
     unsigned char mask = value ^ mode;          // XOR with target mode
-    write_mmu(0xFF41, read_mmu(0xFF41) ^ mask);
+    write_mmu(gb, 0xFF41, read_mmu(gb, 0xFF41) ^ mask);
 }
 
-inline unsigned char lyc() { return read_mmu(0xFF45); }
+inline unsigned char lyc(Gameboy *gb) { return read_mmu(gb, 0xFF45); }
 
-inline void set_coincidence_flag(bool value) {
+inline void set_coincidence_flag(Gameboy *gb, bool value) {
     if (value) {
-        write_mmu(0xFF41, read_mmu(0xFF41) | (1 << 2));
+        write_mmu(gb, 0xFF41, read_mmu(gb, 0xFF41) | (1 << 2));
     } else {
-        write_mmu(0xFF41, read_mmu(0xFF41) & ~(1 << 2));
+        write_mmu(gb, 0xFF41, read_mmu(gb, 0xFF41) & ~(1 << 2));
     }
 }
 
-inline bool coincidence_interrupt() { return read_mmu(0xFF41) >> 6 & 1; }
+inline bool coincidence_interrupt(Gameboy *gb) { return read_mmu(gb, 0xFF41) >> 6 & 1; }
 
 /*
  * FF44 - LY - LCDC Y-Coordinate (R) The LY indicates the vertical line to which the present data is transferred
  * to the LCD Driver. The LY can take on any value between 0 through 153. The values between 144 and 153
  * indicate the V-Blank period. Writing will reset the counter.
  */
-inline void set_ly(unsigned char y) {
-    write_mmu(0xFF44, y);
+inline void set_ly(Gameboy *gb, unsigned char y) {
+    write_mmu(gb, 0xFF44, y);
 
-    if (lyc() == y) {
-        set_coincidence_flag(true);
-        if (coincidence_interrupt()) {
-            set_lcd_stat();
+    if (lyc(gb) == y) {
+        set_coincidence_flag(gb, true);
+        if (coincidence_interrupt(gb)) {
+            set_lcd_stat(gb);
         }
     } else {
-        set_coincidence_flag(false);
+        set_coincidence_flag(gb, false);
     }
 }
 
-inline unsigned char lcdc() { return read_mmu(0xFF40); }
-
-inline bool obj_sprite_size() { return lcdc() >> 2 & 1; }
-inline bool bg_tile_map_display_select() { return lcdc() >> 3 & 1; }
-inline bool bg_window_tile_data_select() { return lcdc() >> 4 & 1; }
-inline bool window_display_enable() { return lcdc() >> 5 & 1; }
-inline bool window_tile_map_display_select() { return lcdc() >> 6 & 1; }
-inline bool lcd_display_enable() { return lcdc() >> 7 & 1; }
+inline unsigned char lcdc(Gameboy *gb) { return read_mmu(gb, 0xFF40); }
 
-inline unsigned short get_tile(unsigned char x, unsigned char y, bool window) {
-    bool map_display_select = window ? window_tile_map_display_select() : bg_tile_map_display_select();
-    unsigned char tile = read_mmu((map_display_select ? 0x9C00 : 0x9800) + y * 32 + x);
-
-    return (bg_window_tile_data_select() ? 0x8000 : 0x9000) +
-           (!bg_window_tile_data_select() || map_display_select ? (tile ^ 0x80) - 0x80 : tile) * 16;
-}
+inline bool obj_sprite_size(Gameboy *gb) { return lcdc(gb) >> 2 & 1; }
+inline bool bg_tile_map_display_select(Gameboy *gb) { return lcdc(gb) >> 3 & 1; }
+inline bool bg_window_tile_data_select(Gameboy *gb) { return lcdc(gb) >> 4 & 1; }
+inline bool window_display_enable(Gameboy *gb) { return lcdc(gb) >> 5 & 1; }
+inline bool window_tile_map_display_select(Gameboy *gb) { return lcdc(gb) >> 6 & 1; }
+inline bool lcd_display_enable(Gameboy *gb) { return lcdc(gb) >> 7 & 1; }
 
 #endif // LIBCBOY_MMU_H
\ No newline at end of file
@@ -0,0 +1,97 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "pacer.h"
+
+// 70224 clks per frame at 4194304 Hz
+#define FRAME_NS (70224 * 1e9 / 4194304)
+
+static long long now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void sleep_until(long long when) {
+#ifdef __linux__
+    struct timespec ts = {when / 1000000000, when % 1000000000};
+    int error;
+    while ((error = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL)) == EINTR)
+        ; // interrupted by a signal
+    if (error == 0)
+        return;
+#endif
+    // no absolute sleep, the deadline of the next frame still corrects the error
+    long long left = when - now();
+    if (left > 0) {
+        struct timespec ts = {left / 1000000000, left % 1000000000};
+        nanosleep(&ts, NULL);
+    }
+}
+
+void init_pacer(Pacer *p) {
+    memset(p, 0, sizeof(Pacer));
+    p->speed = 1;
+    reset_pacer_stats(p);
+}
+
+void set_pacer_speed(Pacer *p, double speed) { p->speed = speed; }
+
+void pace_frame(Pacer *p) {
+    long long time = now();
+
+    if (p->speed > 0) {
+        double period = FRAME_NS / p->speed;
+
+        // the first frame, or one after running unthrottled or falling far behind, starts over from now
+        p->deadline = p->deadline > 0 ? p->deadline + period : time;
+        if (time - p->deadline > PACER_SLACK * period)
+            p->deadline = time;
+
+        long long deadline = (long long)p->deadline;
+        p->late += time > deadline;
+
+        if (deadline - p->spin > time)
+            sleep_until(deadline - p->spin);
+        do
+            time = now();
+        while (time < deadline);
+
+        if (time - deadline > p->max_wake)
+            p->max_wake = time - deadline;
+    } else {
+        p->deadline = 0;
+    }
+
+    if (p->last > 0) {
+        long long frame = time - p->last;
+        p->frames++;
+        p->total += frame;
+        if (frame < p->min)
+            p->min = frame;
+        if (frame > p->max)
+            p->max = frame;
+    }
+    p->last = time;
+}
+
+void reset_pacer_stats(Pacer *p) {
+    p->frames = 0;
+    p->late = 0;
+    p->total = 0;
+    p->min = 0x7FFFFFFFFFFFFFFFLL;
+    p->max = 0;
+    p->max_wake = 0;
+}
+
+void pacer_report(Pacer *p, FILE *out) {
+    if (p->frames == 0)
+        return;
+
+    fprintf(out, "%llu frames, %.3f ms mean, %.3f ms min, %.3f ms max, %.1f fps, %llu late, woke up to %.3f ms late\n",
+            p->frames, p->total / 1e6 / p->frames, p->min / 1e6, p->max / 1e6, p->frames * 1e9 / p->total, p->late,
+            p->max_wake / 1e6);
+}
\ No newline at end of file
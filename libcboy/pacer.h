@@ -0,0 +1,58 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIBCBOY_PACER_H
+#define LIBCBOY_PACER_H
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Pacer Pacer;
+
+/*
+ * Paces the frames of a frontend to the DMG frame rate of 4194304 / 70224 Hz, about 59.73 Hz.
+ *
+ * Every frame has an absolute deadline one period after the one before, so the time lost to sleeping
+ * too long is made up by the next frame instead of adding up. A frame that is more than PACER_SLACK
+ * periods late starts the deadlines over from now, e.g. after the frontend was paused.
+ *
+ * The sleep ends spin nanoseconds before the deadline, the rest is waited for by polling the clock,
+ * which is more precise than waking up from a sleep.
+ */
+struct Pacer {
+    double speed;        // 1 is the DMG rate, 0.5 slow motion, 2 twice as fast, 0 unthrottled
+    long long spin;      // nanoseconds of busy waiting before each deadline, 0 only sleeps
+    double deadline;     // of the last frame in nanoseconds on the monotonic clock, 0 starts over
+    long long last;      // when the last frame was released
+
+    // frame times since the last reset_pacer_stats, from one release to the next
+    unsigned long long frames;
+    unsigned long long late; // frames that were still emulated at their deadline
+    long long total;
+    long long min;
+    long long max;
+    long long max_wake; // the longest time a frame was released past its deadline
+};
+
+#define PACER_SLACK 4
+
+void init_pacer(Pacer *p);
+
+// takes effect from the next frame on, fast-forward is speed 0
+void set_pacer_speed(Pacer *p, double speed);
+
+// waits until the deadline of the frame that was just emulated
+void pace_frame(Pacer *p);
+
+void reset_pacer_stats(Pacer *p);
+
+// writes the number of frames, the mean, min and max frame time, the late frames and the worst wake up
+void pacer_report(Pacer *p, FILE *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCBOY_PACER_H
\ No newline at end of file
@@ -0,0 +1,210 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy.h"
+
+#ifdef __SWITCH__
+
+bool start_pipeline(Gameboy *gb) {
+    (void)gb;
+    return false;
+}
+
+void stop_pipeline(Gameboy *gb) { (void)gb; }
+void record_write(Gameboy *gb, const unsigned char *target) { (void)gb, (void)target; }
+void record_line(Gameboy *gb, unsigned char ly) { (void)gb, (void)ly; }
+void submit_frame(Gameboy *gb) { (void)gb; }
+void finish_frame(Gameboy *gb) { (void)gb; }
+
+#else
+
+#include <pthread.h>
+
+// offset of a byte written in struct Gameboy, or DRAW_LINE to draw the line in value
+typedef struct {
+    unsigned int offset;
+    unsigned char value;
+} Record;
+
+#define DRAW_LINE 0xFFFFFFFF
+
+typedef struct {
+    Record *records;
+    unsigned int count;
+    unsigned int capacity;
+} Log;
+
+struct Pipeline {
+    Gameboy *shadow; // drawn by the worker
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool busy;
+    bool quit;
+    Log recording; // written by the emulation thread
+    Log drawing;   // replayed by the worker
+};
+
+static void append(Log *log, unsigned int offset, unsigned char value) {
+    if (log->count == log->capacity) {
+        log->capacity = log->capacity ? log->capacity * 2 : 4096;
+        log->records = realloc(log->records, log->capacity * sizeof(Record));
+    }
+    log->records[log->count++] = (Record){offset, value};
+}
+
+void record_write(Gameboy *gb, const unsigned char *target) {
+    append(&gb->display.pipeline->recording, target - (unsigned char *)gb, *target);
+}
+
+void record_line(Gameboy *gb, unsigned char ly) {
+    Display *d = &gb->display;
+
+    record_write(gb, &d->scy[ly]);
+    record_write(gb, &d->scx[ly]);
+    record_write(gb, &d->wy[ly]);
+    record_write(gb, &d->wx[ly]);
+    append(&d->pipeline->recording, DRAW_LINE, ly);
+}
+
+// the decoded tiles of the shadow have to be dropped when their data changes, its colors when a palette does
+static void replay(Gameboy *shadow, Record record) {
+    unsigned char *target = (unsigned char *)shadow + record.offset;
+    *target = record.value;
+
+    unsigned int bank0 = record.offset - offsetof(Gameboy, mmu.ram);
+    unsigned int bank1 = record.offset - offsetof(Gameboy, mmu.vram_bank);
+
+    if (bank0 < 0x1800)
+        shadow->display.tiles.valid[0][bank0 >> 4] = false;
+    else if (bank1 < 0x1800)
+        shadow->display.tiles.valid[1][bank1 >> 4] = false;
+    else
+        update_colors(shadow, target);
+}
+
+static void *run_worker(void *arg) {
+    Pipeline *p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    while (true) {
+        while (!p->busy && !p->quit)
+            pthread_cond_wait(&p->cond, &p->lock);
+        if (p->quit)
+            break;
+        pthread_mutex_unlock(&p->lock);
+
+        for (unsigned int i = 0; i < p->drawing.count; i++) {
+            Record record = p->drawing.records[i];
+            if (record.offset == DRAW_LINE)
+                render_line(p->shadow, record.value);
+            else
+                replay(p->shadow, record);
+        }
+        p->drawing.count = 0;
+
+        pthread_mutex_lock(&p->lock);
+        p->busy = false;
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+bool start_pipeline(Gameboy *gb) {
+    if (gb->display.pipeline != NULL)
+        return true;
+
+    Pipeline *p = calloc(1, sizeof(Pipeline));
+    if (p == NULL)
+        return false;
+
+    p->shadow = malloc(sizeof(Gameboy));
+    if (p->shadow == NULL) {
+        free(p);
+        return false;
+    }
+
+    // the shadow only draws, its memory map points into its own copy of the memory
+    memcpy(p->shadow, gb, sizeof(Gameboy));
+    map_memory(p->shadow, 0x80, 0xFF);
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+
+    if (pthread_create(&p->thread, NULL, run_worker, p) != 0) {
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->lock);
+        free(p->shadow);
+        free(p);
+        return false;
+    }
+
+    // writes to VRAM and OAM have to be recorded
+    gb->display.pipeline = p;
+    map_memory(gb, 0x80, 0xFF);
+    return true;
+}
+
+void submit_frame(Gameboy *gb) {
+    Pipeline *p = gb->display.pipeline;
+
+    finish_frame(gb);
+
+    Log log = p->drawing;
+    p->drawing = p->recording;
+    p->recording = log;
+
+    bool converted = p->shadow->display.output.format == gb->display.output.format;
+    p->shadow->display.output = gb->display.output;
+    if (!converted)
+        update_colors(p->shadow, NULL);
+    p->shadow->display.headless = gb->display.headless;
+
+    pthread_mutex_lock(&p->lock);
+    p->busy = true;
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void finish_frame(Gameboy *gb) {
+    Pipeline *p = gb->display.pipeline;
+
+    pthread_mutex_lock(&p->lock);
+    while (p->busy)
+        pthread_cond_wait(&p->cond, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void stop_pipeline(Gameboy *gb) {
+    Pipeline *p = gb->display.pipeline;
+    if (p == NULL)
+        return;
+
+    // draw what is left, the emulation thread continues from the state of the shadow
+    submit_frame(gb);
+    finish_frame(gb);
+    gb->display.window_line = p->shadow->display.window_line;
+
+    pthread_mutex_lock(&p->lock);
+    p->quit = true;
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->thread, NULL);
+
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+    free(p->recording.records);
+    free(p->drawing.records);
+    free(p->shadow);
+    free(p);
+
+    gb->display.pipeline = NULL;
+    map_memory(gb, 0x80, 0xFF);
+}
+
+#endif
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIBCBOY_PIPELINE_H
+#define LIBCBOY_PIPELINE_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Draws the frames on a worker thread while the CPU emulates the next one.
+ *
+ * The worker keeps its own copy of everything drawing depends on: VRAM, OAM, the palettes, LCDC and the
+ * latched scroll positions. Every write to them is recorded in order with the lines drawn in between,
+ * the worker replays the record, so the frames are the same as the ones drawn on the emulation thread.
+ *
+ * next_frame hands the frame recorded by the previous call to the worker and waits for it before it
+ * returns, the frame output always holds the frame before the one just emulated.
+ */
+
+typedef struct Gameboy Gameboy;
+typedef struct Pipeline Pipeline;
+
+// false when no thread can be started
+bool start_pipeline(Gameboy *gb);
+
+// waits for the worker, drawing continues on the emulation thread
+void stop_pipeline(Gameboy *gb);
+
+// called by the emulation thread while the pipeline runs
+void record_write(Gameboy *gb, const unsigned char *target);
+void record_line(Gameboy *gb, unsigned char ly);
+void submit_frame(Gameboy *gb);
+void finish_frame(Gameboy *gb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCBOY_PIPELINE_H
@@ -0,0 +1,205 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <stddef.h>
+
+#include "pixels.h"
+
+#define WIDTH 160
+
+static void decode_tile_scalar(const unsigned char *data, unsigned char pixels[2][8][8]) {
+    for (unsigned char row = 0; row < 8; row++) {
+        unsigned char first = data[row * 2];
+        unsigned char second = data[row * 2 + 1];
+
+        for (unsigned char x = 0; x < 8; x++) {
+            unsigned char color = ((first >> (7 - x)) & 1) | ((second >> (7 - x)) & 1) << 1;
+            pixels[0][row][x] = color;
+            pixels[1][row][7 - x] = color;
+        }
+    }
+}
+
+static void map_line8_scalar(const unsigned char *indices, const unsigned char *colors, unsigned char *out) {
+    for (unsigned char x = 0; x < WIDTH; x++)
+        out[x] = colors[indices[x]];
+}
+
+static void map_line16_scalar(const unsigned char *indices, const unsigned short *colors, unsigned short *out) {
+    for (unsigned char x = 0; x < WIDTH; x++)
+        out[x] = colors[indices[x]];
+}
+
+static void map_line32_scalar(const unsigned char *indices, const unsigned int *colors, unsigned int *out) {
+    for (unsigned char x = 0; x < WIDTH; x++)
+        out[x] = colors[indices[x]];
+}
+
+static const PixelKernels scalar = {"scalar", decode_tile_scalar, map_line8_scalar, map_line16_scalar,
+                                    map_line32_scalar};
+
+#if defined(__x86_64__) && defined(__GNUC__)
+
+#include <immintrin.h>
+
+/*
+ * The bitplanes are split into first and second bytes, each byte is repeated for the 8 pixels of its row
+ * and tested against the bit of every pixel.
+ */
+static void decode_tile_sse2(const unsigned char *data, unsigned char pixels[2][8][8]) {
+    __m128i rows = _mm_loadu_si128((const __m128i *)data);
+    __m128i low = _mm_set1_epi16(0xFF);
+    __m128i planes = _mm_packus_epi16(_mm_and_si128(rows, low), _mm_srli_epi16(rows, 8));
+
+    __m128i bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i flipped_bits = _mm_set_epi8(-128, 64, 32, 16, 8, 4, 2, 1, -128, 64, 32, 16, 8, 4, 2, 1);
+    __m128i one = _mm_set1_epi8(1), two = _mm_set1_epi8(2);
+
+    // bytes 0-7 of planes are the first bitplane, 8-15 the second
+    __m128i first = _mm_unpacklo_epi8(planes, planes);
+    __m128i second = _mm_unpackhi_epi8(planes, planes);
+
+    for (unsigned char pair = 0; pair < 4; pair++) {
+        // two rows, every byte repeated 8 times
+        __m128i f = _mm_unpacklo_epi16(first, first), s = _mm_unpacklo_epi16(second, second);
+        f = pair & 1 ? _mm_unpackhi_epi32(f, f) : _mm_unpacklo_epi32(f, f);
+        s = pair & 1 ? _mm_unpackhi_epi32(s, s) : _mm_unpacklo_epi32(s, s);
+
+        __m128i color = _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(f, bits), bits), one),
+                                     _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(s, bits), bits), two));
+        __m128i flipped =
+            _mm_or_si128(_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(f, flipped_bits), flipped_bits), one),
+                         _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(s, flipped_bits), flipped_bits), two));
+
+        _mm_storeu_si128((__m128i *)pixels[0][pair * 2], color);
+        _mm_storeu_si128((__m128i *)pixels[1][pair * 2], flipped);
+
+        if (pair & 1) {
+            first = _mm_srli_si128(first, 8);
+            second = _mm_srli_si128(second, 8);
+        }
+    }
+}
+
+static const PixelKernels sse2 = {"sse2", decode_tile_sse2, map_line8_scalar, map_line16_scalar, map_line32_scalar};
+
+// four rows at a time, both bitplanes are picked out of the 16 bytes with shuffles
+__attribute__((target("avx2"))) static void decode_tile_avx2(const unsigned char *data,
+                                                             unsigned char pixels[2][8][8]) {
+    __m256i rows = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)data));
+
+    __m256i bits = _mm256_set1_epi64x(0x0102040810204080);
+    __m256i flipped_bits = _mm256_set1_epi64x((long long)0x8040201008040201);
+    __m256i one = _mm256_set1_epi8(1), two = _mm256_set1_epi8(2);
+
+    for (unsigned char half = 0; half < 2; half++) {
+        // row r of this half is byte 2r of the tile in lane r / 2, repeated 8 times
+        char r = half * 8;
+        __m256i f = _mm256_shuffle_epi8(
+            rows, _mm256_setr_epi8(r, r, r, r, r, r, r, r, r + 2, r + 2, r + 2, r + 2, r + 2, r + 2, r + 2, r + 2,
+                                   r + 4, r + 4, r + 4, r + 4, r + 4, r + 4, r + 4, r + 4, r + 6, r + 6, r + 6, r + 6,
+                                   r + 6, r + 6, r + 6, r + 6));
+        __m256i s = _mm256_shuffle_epi8(
+            rows, _mm256_setr_epi8(r + 1, r + 1, r + 1, r + 1, r + 1, r + 1, r + 1, r + 1, r + 3, r + 3, r + 3, r + 3,
+                                   r + 3, r + 3, r + 3, r + 3, r + 5, r + 5, r + 5, r + 5, r + 5, r + 5, r + 5, r + 5,
+                                   r + 7, r + 7, r + 7, r + 7, r + 7, r + 7, r + 7, r + 7));
+
+        __m256i color =
+            _mm256_or_si256(_mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(f, bits), bits), one),
+                            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(s, bits), bits), two));
+        __m256i flipped = _mm256_or_si256(
+            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(f, flipped_bits), flipped_bits), one),
+            _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(s, flipped_bits), flipped_bits), two));
+
+        _mm256_storeu_si256((__m256i *)pixels[0][half * 4], color);
+        _mm256_storeu_si256((__m256i *)pixels[1][half * 4], flipped);
+    }
+}
+
+/*
+ * 32 pixels at a time: every byte of the colors is looked up with shuffles in four tables of 16 colors,
+ * the upper bits of an index select the table. planes holds the tables of one byte of the colors.
+ */
+__attribute__((target("avx2"))) static inline __m256i lookup(const __m256i *planes, __m256i index) {
+    __m256i column = _mm256_and_si256(index, _mm256_set1_epi8(0x0F));
+    __m256i table = _mm256_and_si256(_mm256_srli_epi16(index, 4), _mm256_set1_epi8(3));
+    __m256i bytes = _mm256_setzero_si256();
+
+    for (unsigned char t = 0; t < 4; t++) {
+        __m256i selected = _mm256_cmpeq_epi8(table, _mm256_set1_epi8(t));
+        bytes = _mm256_or_si256(bytes, _mm256_and_si256(selected, _mm256_shuffle_epi8(planes[t], column)));
+    }
+    return bytes;
+}
+
+__attribute__((target("avx2"))) static void map_line8_avx2(const unsigned char *indices, const unsigned char *colors,
+                                                           unsigned char *out) {
+    __m256i planes[4];
+    for (unsigned char t = 0; t < 4; t++)
+        planes[t] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)(colors + t * 16)));
+
+    for (unsigned char x = 0; x < WIDTH; x += 32) {
+        __m256i index = _mm256_loadu_si256((const __m256i *)(indices + x));
+        _mm256_storeu_si256((__m256i *)(out + x), lookup(planes, index));
+    }
+}
+
+__attribute__((target("avx2"))) static void map_line16_avx2(const unsigned char *indices,
+                                                            const unsigned short *colors, unsigned short *out) {
+    __m256i low[4], high[4];
+    for (unsigned char t = 0; t < 4; t++) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(colors + t * 16));
+        __m128i b = _mm_loadu_si128((const __m128i *)(colors + t * 16 + 8));
+        __m128i mask = _mm_set1_epi16(0xFF);
+        low[t] = _mm256_broadcastsi128_si256(_mm_packus_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask)));
+        high[t] = _mm256_broadcastsi128_si256(_mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8)));
+    }
+
+    for (unsigned char x = 0; x < WIDTH; x += 32) {
+        __m256i index = _mm256_loadu_si256((const __m256i *)(indices + x));
+        __m256i lo = lookup(low, index), hi = lookup(high, index);
+
+        // unpacking works per 128 bit lane, pixels 0-7 and 16-23 end up in a, 8-15 and 24-31 in b
+        __m256i a = _mm256_unpacklo_epi8(lo, hi);
+        __m256i b = _mm256_unpackhi_epi8(lo, hi);
+        _mm256_storeu_si256((__m256i *)(out + x), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + x + 16), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+}
+
+// gathers beat four lookups of one byte each
+__attribute__((target("avx2"))) static void map_line32_avx2(const unsigned char *indices, const unsigned int *colors,
+                                                            unsigned int *out) {
+    for (unsigned char x = 0; x < WIDTH; x += 8) {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(indices + x)));
+        _mm256_storeu_si256((__m256i *)(out + x), _mm256_i32gather_epi32((const int *)colors, index, 4));
+    }
+}
+
+static const PixelKernels avx2 = {"avx2", decode_tile_avx2, map_line8_avx2, map_line16_avx2, map_line32_avx2};
+
+const PixelKernels *pixel_kernels(KernelLevel level) {
+    switch (level) {
+        case KERNELS_SCALAR:
+            return &scalar;
+        case KERNELS_SSE2:
+            // part of x86-64
+            return &sse2;
+        case KERNELS_AVX2:
+            return __builtin_cpu_supports("avx2") ? &avx2 : NULL;
+    }
+    return NULL;
+}
+
+#else
+
+const PixelKernels *pixel_kernels(KernelLevel level) { return level == KERNELS_SCALAR ? &scalar : NULL; }
+
+#endif
+
+const PixelKernels *best_pixel_kernels(void) {
+    for (KernelLevel level = KERNELS_AVX2; level > KERNELS_SCALAR; level--) {
+        if (pixel_kernels(level) != NULL)
+            return pixel_kernels(level);
+    }
+    return &scalar;
+}
\ No newline at end of file
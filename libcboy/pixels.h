@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIBCBOY_PIXELS_H
+#define LIBCBOY_PIXELS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Pixel kernels of the renderer, in a portable version and in versions for x86-64 vector extensions.
+ * All of them produce the same output, the fastest one that the host CPU supports is picked at runtime.
+ */
+
+typedef enum { KERNELS_SCALAR, KERNELS_SSE2, KERNELS_AVX2 } KernelLevel;
+
+typedef struct {
+    const char *name;
+
+    // interleaves the two bitplanes of the 8 rows of a tile into one color index per pixel,
+    // pixels[0] as stored and pixels[1] flipped horizontally
+    void (*decode_tile)(const unsigned char *data, unsigned char pixels[2][8][8]);
+
+    // map the 160 color indices of a line through a table of 64 colors of 8, 16 or 32 bits
+    void (*map_line8)(const unsigned char *indices, const unsigned char *colors, unsigned char *out);
+    void (*map_line16)(const unsigned char *indices, const unsigned short *colors, unsigned short *out);
+    void (*map_line32)(const unsigned char *indices, const unsigned int *colors, unsigned int *out);
+} PixelKernels;
+
+// NULL when the host CPU lacks the instructions
+const PixelKernels *pixel_kernels(KernelLevel level);
+
+const PixelKernels *best_pixel_kernels(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCBOY_PIXELS_H
\ No newline at end of file
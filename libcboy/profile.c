@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifdef PROFILE
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy.h"
+#include "instructions/opcodes.h"
+#include "mbc.h"
+
+#define NAME(OPCODE, HANDLER) [OPCODE] = #HANDLER,
+#define NAME_NONE(OPCODE) [OPCODE] = "ILLEGAL",
+#define NAME_PREFIX(OPCODE) [OPCODE] = "PREFIX_CB",
+
+static const char *names[0x100] = {OPCODES(NAME, NAME, NAME, NAME_NONE, NAME_PREFIX)};
+
+static const char *cb_names[0x100] = {CB_OPCODES(NAME)};
+
+static const char *interrupt_names[5] = {"V-Blank", "LCD STAT", "Timer", "Serial", "Joypad"};
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long cycles;
+    unsigned char bank;
+    unsigned short pc; // or the opcode
+} Row;
+
+// the byte at addr like the CPU fetches it, without the side effects of reading IO registers
+static unsigned char peek(Gameboy *gb, unsigned short addr) {
+    unsigned char *page = gb->map.read[addr >> 8];
+    if (page != NULL)
+        return page[addr & 0xFF];
+    return addr >= 0xFF00 ? gb->mmu.ram[addr - 0x8000] : read_mbc(gb, addr);
+}
+
+void profile_instruction(Gameboy *gb) {
+    Profile *p = &gb->profile;
+    unsigned short pc = gb->cpu.PC;
+    unsigned char bank = pc >= 0x4000 && pc < 0x8000 ? gb->mmu.mbc.rom_bank_number : 0;
+
+    if (p->counts[bank] == NULL)
+        p->counts[bank] = calloc(bank == 0 ? 0x10000 : 0x4000, sizeof(unsigned long long));
+    p->counts[bank][bank == 0 ? pc : pc - 0x4000]++;
+
+    p->opcode = peek(gb, pc);
+    p->cb = p->opcode == 0xCB;
+
+    if (p->cb) {
+        p->opcode = peek(gb, pc + 1);
+        p->cb_opcodes[p->opcode]++;
+    } else {
+        p->opcodes[p->opcode]++;
+    }
+}
+
+void profile_cycles(Gameboy *gb, unsigned char cycles) {
+    Profile *p = &gb->profile;
+
+    if (p->cb)
+        p->cb_cycles[p->opcode] += cycles;
+    else
+        p->cycles[p->opcode] += cycles;
+}
+
+void profile_interrupt(Gameboy *gb, unsigned char interrupt) { gb->profile.interrupts[interrupt]++; }
+
+unsigned long long profile_count(Gameboy *gb, unsigned char bank, unsigned short pc) {
+    if (pc < 0x4000 || pc >= 0x8000)
+        bank = 0;
+
+    unsigned long long *counts = gb->profile.counts[bank];
+    if (counts == NULL)
+        return 0;
+
+    return counts[bank == 0 ? pc : pc - 0x4000];
+}
+
+static int compare(const void *a, const void *b) {
+    const Row *x = a, *y = b;
+    if (x->count != y->count)
+        return x->count < y->count ? 1 : -1;
+    if (x->bank != y->bank)
+        return x->bank - y->bank;
+    return x->pc - y->pc;
+}
+
+static void report_opcodes(FILE *out, const char *title, const char *const *names, unsigned long long *opcodes,
+                           unsigned long long *cycles) {
+    Row rows[0x100];
+    unsigned int count = 0;
+
+    for (unsigned int i = 0; i < 0x100; i++) {
+        if (opcodes[i] > 0)
+            rows[count++] = (Row){.count = opcodes[i], .cycles = cycles[i], .pc = i};
+    }
+    qsort(rows, count, sizeof(Row), compare);
+
+    fprintf(out, "%s\n%16s %16s  opcode\n", title, "count", "cycles");
+    for (unsigned int i = 0; i < count; i++)
+        fprintf(out, "%16llu %16llu  %02X %s\n", rows[i].count, rows[i].cycles, rows[i].pc, names[rows[i].pc]);
+    fprintf(out, "\n");
+}
+
+void profile_report(Gameboy *gb, FILE *out, unsigned int limit) {
+    Profile *p = &gb->profile;
+
+    report_opcodes(out, "opcodes", names, p->opcodes, p->cycles);
+    report_opcodes(out, "CB opcodes", cb_names, p->cb_opcodes, p->cb_cycles);
+
+    fprintf(out, "interrupts\n%16s  vector\n", "count");
+    for (unsigned char i = 0; i < 5; i++)
+        fprintf(out, "%16llu  %02X %s\n", p->interrupts[i], 0x40 + i * 8, interrupt_names[i]);
+    fprintf(out, "\n");
+
+    unsigned int count = 0, capacity = 0;
+    Row *rows = NULL;
+
+    for (unsigned int bank = 0; bank < 0x100; bank++) {
+        if (p->counts[bank] == NULL)
+            continue;
+
+        for (unsigned int i = 0; i < (bank == 0 ? 0x10000u : 0x4000u); i++) {
+            if (p->counts[bank][i] == 0)
+                continue;
+
+            if (count == capacity) {
+                capacity = capacity ? capacity * 2 : 1024;
+                rows = realloc(rows, capacity * sizeof(Row));
+            }
+            rows[count++] = (Row){.count = p->counts[bank][i], .bank = bank, .pc = bank == 0 ? i : i + 0x4000};
+        }
+    }
+    qsort(rows, count, sizeof(Row), compare);
+
+    fprintf(out, "hotspots\n%16s  address\n", "count");
+    for (unsigned int i = 0; i < count && i < limit; i++)
+        fprintf(out, "%16llu  %02X:%04X\n", rows[i].count, rows[i].bank, rows[i].pc);
+
+    free(rows);
+}
+
+void profile_reset(Gameboy *gb) {
+    Profile *p = &gb->profile;
+
+    for (unsigned int bank = 0; bank < 0x100; bank++)
+        free(p->counts[bank]);
+
+    memset(p, 0, sizeof(Profile));
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIBCBOY_PROFILE_H
+#define LIBCBOY_PROFILE_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Gameboy Gameboy;
+
+/*
+ * Guest profile, collected by the interpreter cores when built with -DPROFILE=1.
+ *
+ * Execution counts per address are kept for every ROM bank separately: counts[bank] covers 4000-7FFF
+ * of that bank, counts[0] everything else. They are allocated when the first instruction is counted.
+ */
+typedef struct {
+    unsigned long long opcodes[0x100];
+    unsigned long long cycles[0x100];
+    unsigned long long cb_opcodes[0x100];
+    unsigned long long cb_cycles[0x100];
+    unsigned long long interrupts[5]; // entries of the vectors 40, 48, 50, 58 and 60
+    unsigned long long *counts[0x100];
+
+    // instruction that profile_cycles accounts to
+    unsigned char opcode;
+    bool cb;
+} Profile;
+
+#ifdef PROFILE
+
+// counts the instruction at PC, called before it is executed
+void profile_instruction(Gameboy *gb);
+
+// adds the cycles taken by the instruction counted last
+void profile_cycles(Gameboy *gb, unsigned char cycles);
+
+void profile_interrupt(Gameboy *gb, unsigned char interrupt);
+
+// number of times the instruction at bank:pc was executed
+unsigned long long profile_count(Gameboy *gb, unsigned char bank, unsigned short pc);
+
+// writes the opcodes, CB opcodes and the limit hottest addresses sorted by count, and the interrupts
+void profile_report(Gameboy *gb, FILE *out, unsigned int limit);
+
+void profile_reset(Gameboy *gb);
+
+#define PROFILE_INSTRUCTION(gb) profile_instruction(gb)
+#define PROFILE_CYCLES(gb, cycles) profile_cycles(gb, cycles)
+#define PROFILE_INTERRUPT(gb, interrupt) profile_interrupt(gb, interrupt)
+
+#else
+
+#define PROFILE_INSTRUCTION(gb)
+#define PROFILE_CYCLES(gb, cycles)
+#define PROFILE_INTERRUPT(gb, interrupt)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCBOY_PROFILE_H
\ No newline at end of file
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "rom.h"
+
+// 0000-7FFF with bank FF mapped to 4000-7FFF, see mbc_offset
+#define ROM_SPACE 0x400000
+
+/*
+ * 0148 - ROM Size
+ *   00h - 32KByte (2 banks) up to 08h - 8MByte (512 banks), 32KByte << value
+ *   52h - 1.1MByte (72 banks), 53h - 1.2MByte (80 banks), 54h - 1.5MByte (96 banks)
+ */
+static unsigned long header_size(unsigned char value) {
+    if (value <= 8)
+        return 0x8000ul << value;
+    if (value >= 0x52 && value <= 0x54)
+        return (value == 0x52 ? 72 : value == 0x53 ? 80 : 96) * 0x4000ul;
+    return 0;
+}
+
+// the banks of the file or of the size in its header, whichever is larger, bank numbers wrap around at it
+static unsigned int rom_banks(unsigned long size, unsigned char header) {
+    unsigned long length = header_size(header) > size ? header_size(header) : size;
+    unsigned int banks = (length + 0x3FFF) / 0x4000;
+    return banks > 2 ? banks : 2;
+}
+
+#ifdef __SWITCH__
+
+// no mmap, every instance reads its own copy
+unsigned char *map_rom(const char *path, unsigned int *banks) {
+    FILE *file = fopen(path, "rb");
+    if (!file)
+        return NULL;
+
+    unsigned char header = 0;
+    fseek(file, 0, SEEK_END);
+    unsigned long size = ftell(file);
+    if (fseek(file, 0x148, SEEK_SET) != 0 || fread(&header, 1, 1, file) != 1)
+        header = 0;
+    fseek(file, 0, SEEK_SET);
+
+    *banks = rom_banks(size, header);
+
+    unsigned char *rom = calloc(*banks, 0x4000);
+    if (rom)
+        fread(rom, size, 1, file);
+
+    fclose(file);
+    return rom;
+}
+
+void unmap_rom(unsigned char *rom) { free(rom); }
+
+#else
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct Mapping {
+    dev_t device;
+    ino_t inode;
+    unsigned char *data;
+    size_t length;
+    unsigned int banks;
+    unsigned int references;
+    struct Mapping *next;
+} Mapping;
+
+// instances can be loaded from different threads
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static Mapping *mappings;
+
+static unsigned char *map_file(int fd, size_t size, size_t length) {
+    int flags = MAP_SHARED | MAP_FIXED;
+#if defined(ROM_POPULATE) && defined(MAP_POPULATE)
+    flags |= MAP_POPULATE;
+#endif
+
+    // zero pages behind the file, so that reads from missing banks don't fault
+    unsigned char *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+        return NULL;
+
+    if (size > 0 && mmap(data, size, PROT_READ, flags, fd, 0) == MAP_FAILED) {
+        munmap(data, length);
+        return NULL;
+    }
+
+#if defined(ROM_HUGE_PAGES) && defined(MADV_HUGEPAGE)
+    madvise(data, size, MADV_HUGEPAGE);
+#endif
+
+    return data;
+}
+
+unsigned char *map_rom(const char *path, unsigned int *banks) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    Mapping *mapping = mappings;
+    while (mapping != NULL && (mapping->device != st.st_dev || mapping->inode != st.st_ino))
+        mapping = mapping->next;
+
+    if (mapping == NULL) {
+        unsigned char header = 0;
+        if (pread(fd, &header, 1, 0x148) != 1)
+            header = 0;
+
+        size_t length = (size_t)st.st_size > ROM_SPACE ? (size_t)st.st_size : ROM_SPACE;
+        unsigned char *data = map_file(fd, st.st_size, length);
+        mapping = data != NULL ? malloc(sizeof(Mapping)) : NULL;
+
+        if (mapping != NULL) {
+            *mapping = (Mapping){st.st_dev, st.st_ino, data, length, rom_banks(st.st_size, header), 0, mappings};
+            mappings = mapping;
+        } else if (data != NULL) {
+            munmap(data, length);
+        }
+    }
+
+    if (mapping != NULL) {
+        mapping->references++;
+        *banks = mapping->banks;
+    }
+
+    pthread_mutex_unlock(&lock);
+    close(fd);
+
+    return mapping != NULL ? mapping->data : NULL;
+}
+
+void unmap_rom(unsigned char *rom) {
+    pthread_mutex_lock(&lock);
+
+    for (Mapping **link = &mappings; *link != NULL; link = &(*link)->next) {
+        Mapping *mapping = *link;
+        if (mapping->data != rom)
+            continue;
+
+        if (--mapping->references == 0) {
+            *link = mapping->next;
+            munmap(mapping->data, mapping->length);
+            free(mapping);
+        }
+        break;
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+#endif
\ No newline at end of file
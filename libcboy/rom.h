@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIBCBOY_ROM_H
+#define LIBCBOY_ROM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * ROM files are mapped read-only. Every instance that loads the same file gets the same mapping, which
+ * is removed when the last of them unloads it.
+ *
+ * The mapping spans at least the 4MB that 256 ROM banks can address, banks that the file does not
+ * contain read as 0. Without mmap only the banks of the file, or of the size in the header when that is
+ * larger, are read into memory.
+ */
+
+// NULL if the file can't be opened, banks is set to the number of 16KB banks of the file, or of the
+// size in its header when that is larger
+unsigned char *map_rom(const char *path, unsigned int *banks);
+
+// drops the reference taken by map_rom
+void unmap_rom(unsigned char *rom);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCBOY_ROM_H
\ No newline at end of file
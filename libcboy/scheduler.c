@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "gameboy.h"
+
+static bool before(Event *a, Event *b) { return a->when < b->when || (a->when == b->when && a->type < b->type); }
+
+static void place(Scheduler *s, unsigned char i, Event event) {
+    s->heap[i] = event;
+    s->position[event.type] = i + 1;
+}
+
+static void sift_up(Scheduler *s, unsigned char i) {
+    Event event = s->heap[i];
+    while (i > 0 && before(&event, &s->heap[(i - 1) / 2])) {
+        place(s, i, s->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    place(s, i, event);
+}
+
+static void sift_down(Scheduler *s, unsigned char i) {
+    Event event = s->heap[i];
+    while (true) {
+        unsigned char child = i * 2 + 1;
+        if (child >= s->size)
+            break;
+        if (child + 1 < s->size && before(&s->heap[child + 1], &s->heap[child]))
+            child++;
+        if (!before(&s->heap[child], &event))
+            break;
+        place(s, i, s->heap[child]);
+        i = child;
+    }
+    place(s, i, event);
+}
+
+static void update_next(Scheduler *s) { s->next = s->size > 0 ? s->heap[0].when : ~0ULL; }
+
+static void remove_at(Scheduler *s, unsigned char i) {
+    s->position[s->heap[i].type] = 0;
+    s->size--;
+
+    if (i < s->size) {
+        place(s, i, s->heap[s->size]);
+        sift_up(s, i);
+        sift_down(s, s->position[s->heap[i].type] - 1);
+    }
+}
+
+void schedule(Gameboy *gb, unsigned char type, unsigned long long when) {
+    Scheduler *s = &gb->scheduler;
+
+    if (s->position[type] > 0)
+        remove_at(s, s->position[type] - 1);
+
+    place(s, s->size, (Event){.when = when, .type = type});
+    sift_up(s, s->size++);
+    update_next(s);
+}
+
+void cancel(Gameboy *gb, unsigned char type) {
+    Scheduler *s = &gb->scheduler;
+
+    if (s->position[type] > 0) {
+        remove_at(s, s->position[type] - 1);
+        update_next(s);
+    }
+}
+
+void cancel_all(Gameboy *gb) {
+    Scheduler *s = &gb->scheduler;
+
+    s->size = 0;
+    memset(s->position, 0, sizeof(s->position));
+    update_next(s);
+}
+
+void run_events(Gameboy *gb) {
+    Scheduler *s = &gb->scheduler;
+
+    while (s->size > 0 && s->heap[0].when <= s->now) {
+        Event event = s->heap[0];
+        remove_at(s, 0);
+        update_next(s);
+
+        // handlers get the deadline they were scheduled for, so periodic events do not drift
+        switch (event.type) {
+        case EVENT_LINE:
+            line_event(gb, event.when);
+            break;
+        case EVENT_TRANSFER:
+            transfer_event(gb, event.when);
+            break;
+        case EVENT_HBLANK:
+            hblank_event(gb, event.when);
+            break;
+        case EVENT_TIMER:
+            timer_event(gb, event.when);
+            break;
+        case EVENT_DMA:
+            dma_event(gb, event.when);
+            break;
+        case EVENT_SERIAL:
+            serial_event(gb, event.when);
+            break;
+        }
+    }
+}
\ No newline at end of file
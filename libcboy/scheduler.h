@@ -0,0 +1,55 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#ifndef LIBCBOY_SCHEDULER_H
+#define LIBCBOY_SCHEDULER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Gameboy Gameboy;
+
+// every kind of event is pending at most once
+enum {
+    EVENT_LINE,     // LY increment, start of mode 2 or 1
+    EVENT_TRANSFER, // start of mode 3 in a visible line
+    EVENT_HBLANK,   // start of mode 0 in a visible line
+    EVENT_TIMER,    // timer tick, see timer.c
+    EVENT_DMA,      // end of the OAM DMA transfer
+    EVENT_SERIAL,   // end of a serial transfer
+    EVENT_COUNT
+};
+
+typedef struct {
+    unsigned long long when;
+    unsigned char type;
+} Event;
+
+/*
+ * Cycle timestamped events. The CPU runs without looking at any other component until now reaches
+ * next, then run_events hands every due event to its handler.
+ */
+typedef struct {
+    unsigned long long now;  // cycles since power on
+    unsigned long long next; // deadline of the earliest pending event
+    Event heap[EVENT_COUNT]; // min-heap ordered by deadline, then by type
+    unsigned char size;
+    unsigned char position[EVENT_COUNT]; // heap index + 1, 0 while the event is not pending
+} Scheduler;
+
+// (re)schedules an event for the absolute cycle when
+void schedule(Gameboy *gb, unsigned char type, unsigned long long when);
+
+void cancel(Gameboy *gb, unsigned char type);
+
+// drops every pending event
+void cancel_all(Gameboy *gb);
+
+// runs the handlers of all events that are due, in order of their deadlines
+void run_events(Gameboy *gb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCBOY_SCHEDULER_H
\ No newline at end of file
@@ -3,45 +3,108 @@
 #include "gameboy.h"
 #include "mmu.h"
 
-int count = 0;
-int ticks = 0;
+/* FF07 - TAC - Timer Control
+ * Bit 2    - Timer Stop  (0=Stop, 1=Start)
+ * Bits 1-0 - Input Clock Select
+ *            00:   4096 Hz    (~4194 Hz SGB)
+ *            01: 262144 Hz  (~268400 Hz SGB)
+ *            10:  65536 Hz   (~67110 Hz SGB)
+ *            11:  16384 Hz   (~16780 Hz SGB)
+ *
+ * TIMA counts the falling edges of bit 9, 3, 5 or 7 of the system counter, so one increment every
+ * 1024, 16, 64 or 256 clks.
+ */
+static const unsigned short periods[4] = {1024, 16, 64, 256};
 
-void timer(unsigned char cycles) {
-    count += cycles;
-    if (count < 16)
-        return;
+static bool timer_enabled(Gameboy *gb) { return gb->mmu.ram[0xFF07 - 0x8000] >> 2 & 1; }
+
+static unsigned short timer_period(Gameboy *gb) { return periods[gb->mmu.ram[0xFF07 - 0x8000] & 3]; }
+
+void sync_timer(Gameboy *gb) {
+    Timer *t = &gb->timer;
+    unsigned long long now = gb->scheduler.now;
+
+    // FF04 - DIV - Divider Register, the upper byte of the system counter
+    gb->mmu.ram[0xFF04 - 0x8000] = (now - t->div_base) >> 8;
+
+    if (timer_enabled(gb)) {
+        unsigned short period = timer_period(gb);
+        unsigned long long increments = (now - t->div_base) / period - (t->tima_base - t->div_base) / period;
 
-    ticks++;
-    count %= 16;
-
-    if (ticks % 4 == 0)
-        // FF04 - DIV - Divider Register
-        gameboy.mmu.ram[0xFF04 - 0x8000] += 1;
-
-    /* FF07 - TAC - Timer Control
-     * Bit 2    - Timer Stop  (0=Stop, 1=Start)
-     * Bits 1-0 - Input Clock Select
-     *            00:   4096 Hz    (~4194 Hz SGB)
-     *            01: 262144 Hz  (~268400 Hz SGB)
-     *            10:  65536 Hz   (~67110 Hz SGB)
-     *            11:  16384 Hz   (~16780 Hz SGB)
-     */
-    unsigned char TAC = gameboy.mmu.ram[0xFF07 - 0x8000];
-
-    // Timer enable
-    if ((TAC >> 2) & 1) {
-        unsigned char clock = TAC & 3;
-        if ((clock == 0 && (ticks % 64 == 0)) ||
-            clock == 1 ||
-            (clock == 2 && (ticks % 4 == 0)) ||
-            (clock == 3 && (ticks % 16 == 0))) {
-            // FF05 - TIMA - Timer counter
-            if (gameboy.mmu.ram[0xFF05 - 0x8000] == 0xff) {
-                set_interrupt(2);
-                gameboy.mmu.ram[0xFF05 - 0x8000] = gameboy.mmu.ram[0xFF06 - 0x8000];
-            } else {
-                gameboy.mmu.ram[0xFF05 - 0x8000] += 1;
-            }
+        // FF05 - TIMA - Timer counter, reloaded from FF06 - TMA - Timer Modulo when it overflows
+        unsigned int tima = gb->mmu.ram[0xFF05 - 0x8000];
+        while (tima + increments > 0xFF) {
+            increments -= 0x100 - tima;
+            tima = gb->mmu.ram[0xFF06 - 0x8000];
+            set_interrupt(gb, 2);
         }
+        gb->mmu.ram[0xFF05 - 0x8000] = tima + increments;
     }
+
+    t->tima_base = now;
+}
+
+// schedules the next TIMA overflow, expects a synced timer
+static void schedule_overflow(Gameboy *gb) {
+    if (!timer_enabled(gb)) {
+        cancel(gb, EVENT_TIMER);
+        return;
+    }
+
+    Timer *t = &gb->timer;
+    unsigned short period = timer_period(gb);
+    unsigned long long counter = gb->scheduler.now - t->div_base;
+    unsigned int remaining = 0x100 - gb->mmu.ram[0xFF05 - 0x8000];
+
+    schedule(gb, EVENT_TIMER, t->div_base + (counter / period + remaining) * period);
+}
+
+void timer_event(Gameboy *gb, unsigned long long when) {
+    (void)when;
+    sync_timer(gb);
+    schedule_overflow(gb);
+}
+
+void load_timer(Gameboy *gb) {
+    Timer *t = &gb->timer;
+
+    t->div_base = gb->scheduler.now - (gb->mmu.ram[0xFF04 - 0x8000] << 8);
+    t->tima_base = gb->scheduler.now;
+    schedule_overflow(gb);
+}
+
+unsigned char read_div(Gameboy *gb) {
+    sync_timer(gb);
+    return gb->mmu.ram[0xFF04 - 0x8000];
+}
+
+unsigned char read_tima(Gameboy *gb) {
+    sync_timer(gb);
+    return gb->mmu.ram[0xFF05 - 0x8000];
+}
+
+// writing any value resets the system counter
+void write_div(Gameboy *gb, unsigned char value) {
+    (void)value;
+    sync_timer(gb);
+    gb->timer.div_base = gb->scheduler.now;
+    gb->mmu.ram[0xFF04 - 0x8000] = 0;
+    schedule_overflow(gb);
+}
+
+void write_tima(Gameboy *gb, unsigned char value) {
+    sync_timer(gb);
+    gb->mmu.ram[0xFF05 - 0x8000] = value;
+    schedule_overflow(gb);
+}
+
+void write_tma(Gameboy *gb, unsigned char value) {
+    sync_timer(gb);
+    gb->mmu.ram[0xFF06 - 0x8000] = value;
+}
+
+void write_tac(Gameboy *gb, unsigned char value) {
+    sync_timer(gb);
+    gb->mmu.ram[0xFF07 - 0x8000] = value;
+    schedule_overflow(gb);
 }
\ No newline at end of file
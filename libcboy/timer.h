@@ -3,6 +3,30 @@
 #ifndef LIBCBOY_TIMER_H
 #define LIBCBOY_TIMER_H
 
-void timer(unsigned char cycles);
+typedef struct Gameboy Gameboy;
+
+/*
+ * DIV and TIMA are only brought up to date when they are accessed, from the cycles that have passed
+ * since the last time. The TIMA overflow is scheduled as EVENT_TIMER.
+ */
+typedef struct {
+    unsigned long long div_base;  // cycle at which the system counter was reset
+    unsigned long long tima_base; // cycle up to which TIMA is counted
+} Timer;
+
+// updates DIV and TIMA in mmu.ram to the current cycle
+void sync_timer(Gameboy *gb);
+
+// restarts the timer from the DIV, TIMA and TAC in mmu.ram, after loading a state
+void load_timer(Gameboy *gb);
+
+void timer_event(Gameboy *gb, unsigned long long when);
+
+unsigned char read_div(Gameboy *gb);
+unsigned char read_tima(Gameboy *gb);
+void write_div(Gameboy *gb, unsigned char value);
+void write_tima(Gameboy *gb, unsigned char value);
+void write_tma(Gameboy *gb, unsigned char value);
+void write_tac(Gameboy *gb, unsigned char value);
 
 #endif // LIBCBOY_TIMER_H
\ No newline at end of file
@@ -21,6 +21,11 @@
 #define SCALE FB_HEIGHT / HEIGHT
 #define X_OFFSET 50
 
+static Gameboy gameboy;
+
+// the RGBA8888 frame, scaled up into the framebuffer
+static u32 pixels[HEIGHT][WIDTH];
+
 // Main program entrypoint
 int main(int argc, char *argv[]) {
     // Retrieve the default window
@@ -31,8 +36,8 @@ int main(int argc, char *argv[]) {
     framebufferCreate(&fb, win, FB_WIDTH, FB_HEIGHT, PIXEL_FORMAT_RGBA_8888, 2);
     framebufferMakeLinear(&fb);
 
-    Frame buffer;
-    load_rom("/switch/rom.gb");
+    load_rom(&gameboy, "/switch/rom.gb");
+    set_frame_output(&gameboy, pixels, sizeof(pixels[0]), PIXEL_RGBA8888);
 
     // Main loop
     while (appletMainLoop()) {
@@ -47,52 +52,52 @@ int main(int argc, char *argv[]) {
         if (kDown & KEY_PLUS)
             break; // break in order to return to hbmenu
 
-        release_all();
+        release_all(&gameboy);
 
         if (kDown & KEY_A)
-            press(CBOY_KEY_A);
+            press(&gameboy, CBOY_KEY_A);
 
         if (kDown & KEY_B)
-            press(CBOY_KEY_B);
+            press(&gameboy, CBOY_KEY_B);
 
         if ((kDown & KEY_UP) || (kHeld & KEY_UP))
-            press(UP);
+            press(&gameboy, UP);
 
         if ((kDown & KEY_DOWN) || (kHeld & KEY_DOWN))
-            press(DOWN);
+            press(&gameboy, DOWN);
 
         if ((kDown & KEY_LEFT) || (kHeld & KEY_LEFT))
-            press(LEFT);
+            press(&gameboy, LEFT);
 
         if ((kDown & KEY_RIGHT) || (kHeld & KEY_RIGHT))
-            press(RIGHT);
+            press(&gameboy, RIGHT);
 
         if (kDown & KEY_Y)
-            press(SELECT);
+            press(&gameboy, SELECT);
 
         if (kDown & KEY_X)
-            press(START);
+            press(&gameboy, START);
 
         if (kDown & KEY_L)
-            load_state();
+            load_state(&gameboy);
 
         if (kDown & KEY_R)
-            save_state();
+            save_state(&gameboy);
 
         // Retrieve the framebuffer
         u32 stride;
         u32 *framebuffer = (u32 *)framebufferBegin(&fb, &stride);
 
-        buffer = next_frame();
+        next_frame(&gameboy);
 
         for (unsigned char y = 0; y < HEIGHT; y++) {
             for (unsigned char x = 0; x < WIDTH; x++) {
-                u32 color = buffer.buffer[y][x];
+                u32 color = pixels[y][x];
                 u32 pos = y * stride / sizeof(u32) + x + X_OFFSET;
 
                 for (unsigned char py = 0; py < SCALE; py++) {
                     for (unsigned char px = 0; px < SCALE; px++) {
-                        framebuffer[pos * SCALE + py * stride / sizeof(u32) + px] = RGBA8_MAXALPHA((color & 0x1f) * 8, ((color >> 5) & 0x1f) * 8, ((color >> 10) & 0x1f) * 8);
+                        framebuffer[pos * SCALE + py * stride / sizeof(u32) + px] = color;
                     }
                 }
             }
@@ -106,6 +111,8 @@ int main(int argc, char *argv[]) {
     return 0;
 }
 
-void serial_print(char c) {
+void serial_print(Gameboy *gb, char c) {
     // no output
+    (void)gb;
+    (void)c;
 }
\ No newline at end of file
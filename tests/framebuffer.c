@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Runs the framebuffer frontend with FRAMEBUFFER set to a plain file and checks the frames it draws into
+ * it: 640x480 XRGB8888, the 160x144 screen scaled by 3 and centered, nothing drawn outside of it.
+ * Arguments are the frontend, the ROM and the file to draw into.
+ */
+
+#define XRES 640
+#define YRES 480
+#define SCALE 3
+#define X_OFFSET ((XRES - 160 * SCALE) / 2)
+
+static uint32_t screen[YRES][XRES], previous[YRES][XRES];
+
+static bool read_screen(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+        return false;
+    bool ok = fread(screen, sizeof(screen), 1, file) == 1;
+    fclose(file);
+    return ok;
+}
+
+// a frame with text on it, the file starts out as zeros
+static bool drawn(void) {
+    for (unsigned int y = 0; y < 144 * SCALE; y++) {
+        for (unsigned int x = X_OFFSET; x < X_OFFSET + 160 * SCALE; x++) {
+            if (screen[y][x] != screen[0][X_OFFSET])
+                return true;
+        }
+    }
+    return false;
+}
+
+static bool check(void) {
+    for (unsigned int y = 0; y < YRES; y++) {
+        for (unsigned int x = 0; x < XRES; x++) {
+            bool inside = y < 144 * SCALE && x >= X_OFFSET && x < X_OFFSET + 160 * SCALE;
+            if (!inside && screen[y][x] != 0) {
+                printf("%u,%u is outside of the screen but reads %08X\n", x, y, screen[y][x]);
+                return false;
+            }
+
+            // every pixel of the GameBoy is a block of SCALE x SCALE
+            uint32_t pixel = screen[y - y % SCALE][x - (x - X_OFFSET) % SCALE];
+            if (inside && screen[y][x] != pixel) {
+                printf("%u,%u reads %08X, the rest of its pixel %08X\n", x, y, screen[y][x], pixel);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 4) {
+        puts("Usage: framebuffer <cboy> <rom> <file>");
+        exit(1);
+    }
+
+    unlink(argv[3]);
+    setenv("FRAMEBUFFER", argv[3], 1);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // the frontend prints the serial output of the ROM
+        if (freopen("/dev/null", "w", stdout) != NULL)
+            execl(argv[1], argv[1], argv[2], (char *)NULL);
+        _exit(127);
+    }
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+
+    // until the screen stops changing, frames are only checked whole
+    bool ok = false;
+    for (int i = 0; i < 100 && !ok; i++) {
+        usleep(100000);
+
+        int status;
+        if (waitpid(pid, &status, WNOHANG) != 0) {
+            puts("cboy exited");
+            exit(1);
+        }
+
+        if (read_screen(argv[3])) {
+            ok = drawn() && memcmp(screen, previous, sizeof(screen)) == 0;
+            memcpy(previous, screen, sizeof(screen));
+        }
+    }
+
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+
+    if (!ok) {
+        puts("Nothing was drawn");
+        exit(1);
+    }
+
+    ok = check();
+    unlink(argv[3]);
+    return ok ? 0 : 1;
+}
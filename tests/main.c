@@ -5,7 +5,15 @@
 
 #include "gameboy.h"
 
-void serial_print(char c) {
+static Gameboy gameboy;
+
+#ifdef AOT_TABLE
+// generated by cboy-aot from the ROM under test
+extern const AotTable aot_table;
+#endif
+
+void serial_print(Gameboy *gb, char c) {
+    (void)gb;
     if (c == 'P') {
         // begin of PASSED, test was successful
         exit(0);
@@ -21,11 +29,17 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
 
-    load_rom(argv[1]);
+    load_rom(&gameboy, argv[1]);
+    set_headless(&gameboy, true);
+
+#ifdef AOT_TABLE
+    if (!load_aot(&gameboy, &aot_table))
+        exit(1);
+#endif
 
     // run for some frames and fail when there is no result
     for (int i = 0; i < 2000; i++) {
-        next_frame();
+        next_frame(&gameboy);
     }
 
     exit(1);
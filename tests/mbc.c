@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "gameboy.h"
+
+/*
+ * Switches the external RAM bank of a cartridge with 4 RAM banks and checks that enabling and
+ * disabling the RAM keeps the selected bank mapped to A000-BFFF, and that the disabled RAM reads FF
+ * and ignores writes. The ROM is written to the path given as argument.
+ */
+
+static Gameboy gameboy;
+
+void serial_print(Gameboy *gb, char c) {
+    (void)gb;
+    (void)c;
+}
+
+// an empty MBC1 ROM of 32 KBytes with 32 KBytes of RAM
+static void write_rom(const char *path) {
+    static unsigned char rom[0x8000];
+    rom[0x147] = 0x03;
+    rom[0x149] = 0x03;
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL || fwrite(rom, sizeof(rom), 1, file) != 1) {
+        printf("Could not write %s\n", path);
+        exit(1);
+    }
+    fclose(file);
+}
+
+static bool check(const char *step, unsigned char bank, unsigned char value) {
+    if (gameboy.mmu.mbc.ram_bank_number != bank || read_mmu(&gameboy, 0xA000) != value) {
+        printf("%s: RAM bank %d reads %02X, expected bank %d with %02X\n", step, gameboy.mmu.mbc.ram_bank_number,
+               read_mmu(&gameboy, 0xA000), bank, value);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        puts("No rom file specified");
+        exit(1);
+    }
+
+    write_rom(argv[1]);
+    load_rom(&gameboy, argv[1]);
+
+    write_mmu(&gameboy, 0x0000, 0x0A);
+    write_mmu(&gameboy, 0x4000, 0);
+    write_mmu(&gameboy, 0xA000, 0x11);
+    write_mmu(&gameboy, 0x4000, 1);
+    write_mmu(&gameboy, 0xA000, 0x22);
+
+    bool ok = check("select", 1, 0x22);
+
+    write_mmu(&gameboy, 0x0000, 0x00);
+    write_mmu(&gameboy, 0xA000, 0x33);
+    ok &= check("disable", 1, 0xFF);
+
+    write_mmu(&gameboy, 0x0000, 0x0A);
+    ok &= check("enable", 1, 0x22);
+
+    write_mmu(&gameboy, 0x4000, 0);
+    ok &= check("switch back", 0, 0x11);
+
+    unload_rom(&gameboy);
+    remove(argv[1]);
+    return ok ? 0 : 1;
+}
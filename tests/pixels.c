@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pixels.h"
+
+/*
+ * Checks that the vector kernels produce exactly the output of the scalar ones.
+ * With the argument bench, the kernels are timed instead.
+ */
+
+static const char *level_names[] = {"scalar", "sse2", "avx2"};
+
+static bool test_decode(const PixelKernels *kernels, const PixelKernels *reference) {
+    unsigned char data[16];
+    unsigned char expected[2][8][8], actual[2][8][8];
+
+    // every pair of bitplane bytes, in all rows
+    for (unsigned int planes = 0; planes < 0x10000; planes += 8) {
+        for (unsigned char i = 0; i < 8; i++) {
+            data[i * 2] = planes + i;
+            data[i * 2 + 1] = (planes + i) >> 8;
+        }
+
+        reference->decode_tile(data, expected);
+        kernels->decode_tile(data, actual);
+
+        if (memcmp(expected, actual, sizeof(expected)) != 0) {
+            printf("%s decode_tile differs for %04X\n", kernels->name, planes);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool test_map(const PixelKernels *kernels, const PixelKernels *reference) {
+    unsigned char indices[160];
+    unsigned int colors[64], expected[160], actual[160];
+
+    srand(1);
+    for (unsigned int round = 0; round < 10000; round++) {
+        for (unsigned char i = 0; i < 64; i++)
+            colors[i] = (unsigned int)rand() << 16 ^ rand();
+        for (unsigned char x = 0; x < 160; x++)
+            indices[x] = rand() % 64;
+
+        reference->map_line32(indices, colors, expected);
+        kernels->map_line32(indices, colors, actual);
+        bool same = memcmp(expected, actual, sizeof(expected)) == 0;
+
+        // the same tables narrowed to 16 and 8 bits
+        reference->map_line16(indices, (unsigned short *)colors, (unsigned short *)expected);
+        kernels->map_line16(indices, (unsigned short *)colors, (unsigned short *)actual);
+        same &= memcmp(expected, actual, 160 * sizeof(unsigned short)) == 0;
+
+        reference->map_line8(indices, (unsigned char *)colors, (unsigned char *)expected);
+        kernels->map_line8(indices, (unsigned char *)colors, (unsigned char *)actual);
+        same &= memcmp(expected, actual, 160) == 0;
+
+        if (!same) {
+            printf("%s map_line differs in round %u\n", kernels->name, round);
+            return false;
+        }
+    }
+    return true;
+}
+
+static double seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void bench(const PixelKernels *kernels) {
+    static unsigned char data[384 * 16], pixels[384][2][8][8];
+    static unsigned char indices[144][160];
+    static unsigned int colors[64], out[144][160];
+
+    for (unsigned int i = 0; i < sizeof(data); i++)
+        data[i] = rand();
+    for (unsigned int i = 0; i < sizeof(indices); i++)
+        indices[i / 160][i % 160] = rand() % 64;
+
+    double start = seconds();
+    for (unsigned int round = 0; round < 2000; round++) {
+        for (unsigned int tile = 0; tile < 384; tile++)
+            kernels->decode_tile(data + tile * 16, pixels[tile]);
+    }
+    printf("%-8s decode_tile %6.2f ns/tile\n", kernels->name, (seconds() - start) * 1e9 / (2000 * 384));
+
+    double map[3];
+    for (unsigned char size = 0; size < 3; size++) {
+        start = seconds();
+        for (unsigned int frame = 0; frame < 20000; frame++) {
+            colors[0] = frame;
+            for (unsigned char ly = 0; ly < 144; ly++) {
+                if (size == 0)
+                    kernels->map_line8(indices[ly], (unsigned char *)colors, (unsigned char *)out[ly]);
+                else if (size == 1)
+                    kernels->map_line16(indices[ly], (unsigned short *)colors, (unsigned short *)out[ly]);
+                else
+                    kernels->map_line32(indices[ly], colors, out[ly]);
+            }
+        }
+        map[size] = (seconds() - start) * 1e9 / (20000 * 144);
+    }
+    printf("%-8s map_line %6.2f / %6.2f / %6.2f ns/line for 8 / 16 / 32 bits\n", kernels->name, map[0], map[1], map[2]);
+}
+
+int main(int argc, char *argv[]) {
+    bool timed = argc == 2 && strcmp(argv[1], "bench") == 0;
+    const PixelKernels *reference = pixel_kernels(KERNELS_SCALAR);
+    bool ok = true;
+
+    for (KernelLevel level = KERNELS_SCALAR; level <= KERNELS_AVX2; level++) {
+        const PixelKernels *kernels = pixel_kernels(level);
+        if (kernels == NULL) {
+            printf("%-8s not supported\n", level_names[level]);
+            continue;
+        }
+
+        if (timed)
+            bench(kernels);
+        else if (level != KERNELS_SCALAR)
+            ok &= test_decode(kernels, reference) && test_map(kernels, reference);
+    }
+
+    return ok ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-3.0-only
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gameboy.h"
+
+/*
+ * Runs a ROM with the profiler until it passes and checks that the entry point and at least one CB
+ * opcode were counted, and that the report lists the hotspots.
+ */
+
+static Gameboy gameboy;
+static bool passed;
+
+void serial_print(Gameboy *gb, char c) {
+    (void)gb;
+    if (c == 'P')
+        passed = true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        puts("No rom file specified");
+        exit(1);
+    }
+
+    load_rom(&gameboy, argv[1]);
+    set_headless(&gameboy, true);
+
+    for (int i = 0; i < 2000 && !passed; i++)
+        next_frame(&gameboy);
+
+    bool ok = passed;
+    if (!passed)
+        puts("The ROM did not pass");
+
+    if (profile_count(&gameboy, 0, 0x100) == 0) {
+        puts("The entry point at 0100 was not counted");
+        ok = false;
+    }
+
+    unsigned long long cb = 0;
+    for (unsigned int i = 0; i < 0x100; i++)
+        cb += gameboy.profile.cb_opcodes[i];
+    if (cb == 0) {
+        puts("No CB opcode was counted");
+        ok = false;
+    }
+
+    char report[64] = "";
+    FILE *out = tmpfile();
+    if (out != NULL) {
+        profile_report(&gameboy, out, 1);
+        rewind(out);
+        while (fgets(report, sizeof(report), out) != NULL && strcmp(report, "hotspots\n") != 0)
+            ;
+        fclose(out);
+    }
+    if (strcmp(report, "hotspots\n") != 0) {
+        puts("The report has no hotspots");
+        ok = false;
+    }
+
+    profile_reset(&gameboy);
+    unload_rom(&gameboy);
+    return ok ? 0 : 1;
+}